@@ -0,0 +1,405 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Офлайн-анализ результатов lab8, lab9 и lab10: по сохранённым кривым
+ * латентности находит точки смены уровня и выводит размеры и латентности
+ * кэшей, ассоциативность и число записей dTLB. Если доступен каталог
+ * /sys/devices/system/cpu/cpu0/cache (или заданный --cache-sysfs),
+ * найденные значения сравниваются с ним.
+ *
+ *   g++ -std=c++17 -O2 main.cpp -o analysis
+ *   ./analysis --lab8 ../lab8/results.csv --lab9 ../lab9/results.csv --lab10 lab10.txt
+ *
+ * где lab10.txt - сохранённый вывод ./lab10. В testdata/ лежат записанные
+ * кривые, поддельный каталог кэшей и ожидаемый вывод; testdata/check.sh
+ * сверяет с ним вывод анализатора после изменений разбиения на уровни.
+ */
+
+const double MIN_STEP = 0.22;   // ln(1.25): соседние уровни, отличающиеся меньше чем на 25%, сливаются
+const size_t MIN_SEGMENT = 2;   // одиночные точки обычно лежат на переходе между уровнями
+
+struct Curve {
+    vector<double> x;
+    vector<double> y;
+};
+
+struct Segment {
+    size_t begin;
+    size_t end;
+    double level;
+};
+
+struct SysfsCache {
+    int level;
+    string type;
+    double sizeKB;
+    int ways;
+};
+
+vector<string> split(const string& line, char sep) {
+    vector<string> fields;
+    string field;
+    stringstream ss(line);
+    while (getline(ss, field, sep)) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+bool toDouble(const string& s, double& value) {
+    char* end;
+    value = strtod(s.c_str(), &end);
+    return end != s.c_str();
+}
+
+/* Читает из CSV столбец x (номер xCol) и y (по имени yName или номеру yCol). */
+bool readCsvCurve(const string& path, size_t xCol, const string& yName, size_t yCol, Curve& curve) {
+    ifstream file(path);
+    if (!file.is_open()) {
+        cerr << "Cannot open " << path << endl;
+        return false;
+    }
+    string line;
+    getline(file, line);
+    vector<string> header = split(line, ',');
+    for (size_t i = 0; i < header.size(); ++i) {
+        string name = header[i];
+        name.erase(0, name.find_first_not_of(' '));
+        if (!yName.empty() && name == yName) {
+            yCol = i;
+        }
+    }
+    while (getline(file, line)) {
+        vector<string> fields = split(line, ',');
+        double x, y;
+        if (fields.size() > max(xCol, yCol) && toDouble(fields[xCol], x) && toDouble(fields[yCol], y)) {
+            curve.x.push_back(x);
+            curve.y.push_back(y);
+        }
+    }
+    return !curve.x.empty();
+}
+
+/*
+ * Читает сохранённый вывод lab10: берёт первую таблицу с заголовком
+ * "Entries<TAB>Ticks" (или таблицу режима страниц pages, если он задан).
+ */
+bool readTlbCurve(const string& path, const string& pages, Curve& curve) {
+    ifstream file(path);
+    if (!file.is_open()) {
+        cerr << "Cannot open " << path << endl;
+        return false;
+    }
+    string line;
+    bool wantedSection = pages.empty();
+    bool inTable = false;
+    while (getline(file, line)) {
+        if (line.rfind("Pages: ", 0) == 0) {
+            wantedSection = pages.empty() || line.compare(7, pages.size() + 1, pages + " ") == 0;
+            inTable = false;
+            continue;
+        }
+        if (line.rfind("Entries\tTicks", 0) == 0) {
+            inTable = wantedSection;
+            continue;
+        }
+        if (line.empty() || line.rfind("Entries", 0) == 0) {
+            if (inTable && !curve.x.empty()) {
+                break;
+            }
+            inTable = false;
+            continue;
+        }
+        if (!inTable) {
+            continue;
+        }
+        vector<string> fields = split(line, '\t');
+        double x, y;
+        if (fields.size() >= 2 && toDouble(fields[0], x) && toDouble(fields[1], y)) {
+            curve.x.push_back(x);
+            curve.y.push_back(y);
+        }
+    }
+    return !curve.x.empty();
+}
+
+double median(vector<double> values) {
+    sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+/*
+ * Кусочно-постоянная аппроксимация ln(y) динамическим программированием:
+ * минимизируется SSE + penalty * (число сегментов). Штраф - максимум из
+ * BIC-оценки шума (по медиане соседних разностей) и MIN_STEP^2. После этого
+ * соседние сегменты с уровнями ближе MIN_STEP сливаются, начиная с самых
+ * близких, так что плавный рост латентности не дробится на много уровней.
+ */
+vector<Segment> segmentCurve(const vector<double>& y) {
+    size_t n = y.size();
+    vector<double> v(n), prefix(n + 1, 0), prefixSq(n + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = log(max(y[i], 1e-9));
+        prefix[i + 1] = prefix[i] + v[i];
+        prefixSq[i + 1] = prefixSq[i] + v[i] * v[i];
+    }
+    auto cost = [&](size_t a, size_t b) {
+        double s = prefix[b] - prefix[a];
+        double sq = prefixSq[b] - prefixSq[a];
+        return sq - s * s / (b - a);
+    };
+
+    vector<double> diffs;
+    for (size_t i = 1; i < n; ++i) {
+        diffs.push_back(fabs(v[i] - v[i - 1]));
+    }
+    double sigma = diffs.empty() ? 0 : 1.4826 * median(diffs) / sqrt(2.0);
+    double penalty = max(2 * sigma * sigma * log(static_cast<double>(max<size_t>(n, 2))), MIN_STEP * MIN_STEP);
+
+    size_t minLength = n >= 4 * MIN_SEGMENT ? MIN_SEGMENT : 1;
+    vector<double> best(n + 1, 1e300);
+    vector<size_t> prev(n + 1, 0);
+    best[0] = 0;
+    for (size_t b = 1; b <= n; ++b) {
+        for (size_t a = 0; a + minLength <= b; ++a) {
+            if (best[a] >= 1e300) {
+                continue;
+            }
+            double c = best[a] + cost(a, b) + penalty;
+            if (c < best[b]) {
+                best[b] = c;
+                prev[b] = a;
+            }
+        }
+    }
+    vector<Segment> segments;
+    for (size_t b = n; b > 0; b = prev[b]) {
+        vector<double> part(y.begin() + prev[b], y.begin() + b);
+        segments.push_back({prev[b], b, median(part)});
+    }
+    reverse(segments.begin(), segments.end());
+
+    while (segments.size() > 1) {
+        size_t closest = 0;
+        double closestStep = 1e300;
+        for (size_t i = 0; i + 1 < segments.size(); ++i) {
+            double step = fabs(log(segments[i + 1].level / segments[i].level));
+            if (step < closestStep) {
+                closestStep = step;
+                closest = i;
+            }
+        }
+        if (closestStep >= MIN_STEP) {
+            break;
+        }
+        Segment merged = {segments[closest].begin, segments[closest + 1].end, 0};
+        merged.level = median(vector<double>(y.begin() + merged.begin, y.begin() + merged.end));
+        segments[closest] = merged;
+        segments.erase(segments.begin() + closest + 1);
+    }
+    return segments;
+}
+
+double parseSysfsSize(const string& s) {
+    double value = atof(s.c_str());
+    if (s.find('M') != string::npos) {
+        value *= 1024;
+    }
+    return value;
+}
+
+string readLine(const string& path) {
+    ifstream file(path);
+    string line;
+    getline(file, line);
+    return line;
+}
+
+vector<SysfsCache> readSysfsCaches(const string& root) {
+    vector<SysfsCache> caches;
+    DIR* dir = opendir(root.c_str());
+    if (!dir) {
+        return caches;
+    }
+    while (dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, "index", 5) != 0) {
+            continue;
+        }
+        string base = root + "/" + entry->d_name + "/";
+        SysfsCache cache;
+        cache.level = atoi(readLine(base + "level").c_str());
+        cache.type = readLine(base + "type");
+        cache.sizeKB = parseSysfsSize(readLine(base + "size"));
+        cache.ways = atoi(readLine(base + "ways_of_associativity").c_str());
+        if (cache.type != "Instruction") {
+            caches.push_back(cache);
+        }
+    }
+    closedir(dir);
+    sort(caches.begin(), caches.end(), [](const SysfsCache& a, const SysfsCache& b) { return a.level < b.level; });
+    return caches;
+}
+
+void printSegments(const Curve& curve, const vector<Segment>& segments, const string& xName) {
+    for (const Segment& s : segments) {
+        cout << "  " << xName << " " << curve.x[s.begin] << ".." << curve.x[s.end - 1]
+             << ": " << s.level << " cycles" << endl;
+    }
+}
+
+void analyzeCaches(const Curve& curve, const vector<SysfsCache>& sysfs) {
+    vector<Segment> segments = segmentCurve(curve.y);
+    cout << "Cache levels (lab8, random chase):" << endl;
+    printSegments(curve, segments, "KB");
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const Segment& s = segments[i];
+        if (i + 1 == segments.size()) {
+            cout << "  Memory: latency " << s.level << " cycles" << endl;
+            break;
+        }
+        cout << "  Level " << i + 1 << ": size <= " << curve.x[s.end - 1] << " KB (next point " << curve.x[s.end]
+             << " KB), latency " << s.level << " cycles" << endl;
+    }
+    // Для каждого кэша из sysfs ищется ближайшая (в логарифмическом масштабе) найденная граница.
+    for (const SysfsCache& c : sysfs) {
+        if (segments.size() < 2 || c.sizeKB > curve.x.back()) {
+            continue;
+        }
+        size_t nearest = 0;
+        for (size_t i = 0; i + 1 < segments.size(); ++i) {
+            double d = fabs(log(curve.x[segments[i].end - 1] / c.sizeKB));
+            if (d < fabs(log(curve.x[segments[nearest].end - 1] / c.sizeKB))) {
+                nearest = i;
+            }
+        }
+        cout << "  sysfs L" << c.level << " " << c.sizeKB << " KB ~ step after " << curve.x[segments[nearest].end - 1]
+             << " KB (" << segments[nearest].level << " -> " << segments[nearest + 1].level << " cycles)" << endl;
+    }
+}
+
+void analyzeAssociativity(const Curve& curve, const vector<SysfsCache>& sysfs) {
+    vector<Segment> segments = segmentCurve(curve.y);
+    cout << "Associativity (lab9, fragment sweep):" << endl;
+    printSegments(curve, segments, "fragments");
+    if (segments.size() < 2) {
+        cout << "  no step found" << endl;
+        return;
+    }
+    // Пока фрагментов не больше числа путей, все они помещаются в одно множество;
+    // дальше каждое обращение - промах, и кривая выходит на последнее плато.
+    int ways = static_cast<int>(curve.x[segments[segments.size() - 2].end - 1]);
+    cout << "  Associativity: " << ways << " ways";
+    for (const SysfsCache& c : sysfs) {
+        if (c.ways == ways) {
+            cout << " (matches sysfs L" << c.level << ")";
+            break;
+        }
+    }
+    cout << endl;
+}
+
+/*
+ * Первая ступенька кривой - исчерпание L1 dTLB, самая большая (в разах)
+ * из последующих - исчерпание L2 STLB. Остальные ступеньки выводятся как есть:
+ * на больших числах записей к промахам TLB добавляются промахи кэшей.
+ */
+void analyzeTlb(const Curve& curve) {
+    vector<Segment> segments = segmentCurve(curve.y);
+    cout << "dTLB (lab10, entries sweep):" << endl;
+    printSegments(curve, segments, "entries");
+    vector<size_t> steps;
+    for (size_t i = 0; i + 1 < segments.size(); ++i) {
+        if (segments[i + 1].level > segments[i].level) {
+            steps.push_back(i);
+        }
+    }
+    if (steps.empty()) {
+        cout << "  no step found" << endl;
+        return;
+    }
+    size_t l1 = steps[0];
+    cout << "  L1 dTLB: ~" << curve.x[segments[l1].end - 1] << " entries, miss penalty "
+         << segments[l1 + 1].level - segments[l1].level << " cycles" << endl;
+    if (steps.size() < 2) {
+        return;
+    }
+    size_t l2 = steps[1];
+    for (size_t i : steps) {
+        if (i != l1 && segments[i + 1].level / segments[i].level > segments[l2 + 1].level / segments[l2].level) {
+            l2 = i;
+        }
+    }
+    cout << "  L2 STLB: ~" << curve.x[segments[l2].end - 1] << " entries, miss penalty "
+         << segments[l2 + 1].level - segments[l2].level << " cycles" << endl;
+}
+
+int main(int argc, char** argv) {
+    string lab8Path, lab9Path, lab10Path, pages;
+    string sysfsRoot = "/sys/devices/system/cpu/cpu0/cache";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string opt = argv[i];
+        if (opt == "--lab8") {
+            lab8Path = argv[i + 1];
+        } else if (opt == "--lab9") {
+            lab9Path = argv[i + 1];
+        } else if (opt == "--lab10") {
+            lab10Path = argv[i + 1];
+        } else if (opt == "--pages") {
+            pages = argv[i + 1];
+        } else if (opt == "--cache-sysfs") {
+            sysfsRoot = argv[i + 1];
+        }
+    }
+    if (lab8Path.empty() && lab9Path.empty() && lab10Path.empty()) {
+        cerr << "Usage: " << argv[0] << " [--lab8 results.csv] [--lab9 results.csv] [--lab10 output.txt]"
+             << " [--pages 4k] [--cache-sysfs dir]" << endl;
+        return 1;
+    }
+
+    vector<SysfsCache> sysfs = readSysfsCaches(sysfsRoot);
+    if (!sysfs.empty()) {
+        cout << "sysfs caches:" << endl;
+        for (const SysfsCache& c : sysfs) {
+            cout << "  L" << c.level << " " << c.type << ": " << c.sizeKB << " KB, " << c.ways << " ways" << endl;
+        }
+    }
+
+    int status = 0;
+    if (!lab8Path.empty()) {
+        Curve curve;
+        if (readCsvCurve(lab8Path, 0, "Random", 3, curve)) {
+            analyzeCaches(curve, sysfs);
+        } else {
+            status = 1;
+        }
+    }
+    if (!lab9Path.empty()) {
+        Curve curve;
+        if (readCsvCurve(lab9Path, 0, "Ticks", 1, curve)) {
+            analyzeAssociativity(curve, sysfs);
+        } else {
+            status = 1;
+        }
+    }
+    if (!lab10Path.empty()) {
+        Curve curve;
+        if (readTlbCurve(lab10Path, pages, curve)) {
+            analyzeTlb(curve);
+        } else {
+            status = 1;
+        }
+    }
+    return status;
+}
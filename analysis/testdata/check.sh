@@ -0,0 +1,22 @@
+#!/bin/sh
+# Проверка анализатора на записанных кривых: собирает analysis/main.cpp
+# (или берёт готовый бинарник из первого аргумента), прогоняет его на
+# файлах этого каталога и сравнивает вывод с expected.txt.
+#   sh analysis/testdata/check.sh [путь/к/analysis]
+set -e
+dir=$(cd "$(dirname "$0")" && pwd)
+bin=$1
+if [ -z "$bin" ]; then
+    bin=$(mktemp)
+    trap 'rm -f "$bin"' EXIT
+    ${CXX:-g++} -std=c++17 -O2 "$dir/../main.cpp" -o "$bin"
+fi
+cd "$dir"
+"$bin" --lab8 lab8_results.csv --lab9 lab9_results.csv --lab10 lab10_output.txt --cache-sysfs cache > "$dir/actual.txt"
+if diff -u expected.txt actual.txt; then
+    rm -f actual.txt
+    echo "analysis: OK"
+else
+    echo "analysis: output differs from expected.txt (see actual.txt)"
+    exit 1
+fi
@@ -0,0 +1,259 @@
+#ifndef COMMON_BENCH_H
+#define COMMON_BENCH_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+/*
+ * Общий каркас замеров для lab2, lab8, lab9 и lab10.
+ *
+ * Замер повторяется, пока 95% доверительный интервал среднего (после
+ * отбрасывания выбросов по Тьюки) не станет уже rel_ci от медианы, но
+ * не меньше min_runs и не больше max_runs раз. Пределы можно переопределить
+ * переменными окружения BENCH_MIN_RUNS, BENCH_MAX_RUNS и BENCH_REL_CI.
+ * Результаты пишутся в файл BENCH_OUTPUT (CSV, или JSON Lines при
+ * расширении .json) в одной схеме для всех лаб.
+ */
+
+typedef double (*bench_fn)(void *ctx);
+
+typedef struct {
+    size_t min_runs;
+    size_t max_runs;
+    double rel_ci;
+} bench_config;
+
+typedef struct {
+    size_t runs;
+    size_t outliers;
+    double min;
+    double p5;
+    double median;
+    double p95;
+    double max;
+    double mean;
+    double stddev;
+    double ci95;
+} bench_stats;
+
+typedef struct {
+    FILE *file;
+    int json;
+    const char *bench;
+} bench_report;
+
+static inline uint64_t bench_cycles_begin(void) {
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+}
+
+static inline uint64_t bench_cycles_end(void) {
+    unsigned int aux;
+    uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+}
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/* Частота TSC в ГГц, измеряется один раз за ~50 мс. */
+static inline double bench_tsc_ghz(void) {
+    static double ghz = 0;
+    if (ghz == 0) {
+        uint64_t ns_start = bench_now_ns();
+        uint64_t tsc_start = bench_cycles_begin();
+        while (bench_now_ns() - ns_start < 50000000ull) {
+        }
+        uint64_t tsc_end = bench_cycles_end();
+        uint64_t ns_end = bench_now_ns();
+        ghz = (double) (tsc_end - tsc_start) / (double) (ns_end - ns_start);
+    }
+    return ghz;
+}
+
+static inline double bench_cycles_to_ns(double cycles) {
+    return cycles / bench_tsc_ghz();
+}
+
+static inline int bench_compare_doubles(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static inline double bench_percentile(const double *sorted, size_t n, double p) {
+    double pos = p * (double) (n - 1);
+    size_t lo = (size_t) pos;
+    size_t hi = lo + 1 < n ? lo + 1 : lo;
+    double frac = pos - (double) lo;
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * frac;
+}
+
+/* Двусторонний 95% квантиль t-распределения для df = 1..30, дальше 1.96. */
+static inline double bench_t95(size_t df) {
+    static const double table[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (df == 0) {
+        return INFINITY;
+    }
+    return df <= 30 ? table[df - 1] : 1.96;
+}
+
+/* Сортирует samples на месте и заполняет stats. */
+static inline void bench_compute_stats(double *samples, size_t n, bench_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->runs = n;
+    if (n == 0) {
+        return;
+    }
+    qsort(samples, n, sizeof(double), bench_compare_doubles);
+    stats->min = samples[0];
+    stats->max = samples[n - 1];
+    stats->p5 = bench_percentile(samples, n, 0.05);
+    stats->median = bench_percentile(samples, n, 0.5);
+    stats->p95 = bench_percentile(samples, n, 0.95);
+
+    double q1 = bench_percentile(samples, n, 0.25);
+    double q3 = bench_percentile(samples, n, 0.75);
+    double low = q1 - 1.5 * (q3 - q1);
+    double high = q3 + 1.5 * (q3 - q1);
+    size_t kept = 0;
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (samples[i] >= low && samples[i] <= high) {
+            sum += samples[i];
+            ++kept;
+        }
+    }
+    stats->outliers = n - kept;
+    stats->mean = sum / (double) kept;
+    double sq = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (samples[i] >= low && samples[i] <= high) {
+            sq += (samples[i] - stats->mean) * (samples[i] - stats->mean);
+        }
+    }
+    stats->stddev = kept > 1 ? sqrt(sq / (double) (kept - 1)) : 0;
+    stats->ci95 = kept > 1 ? bench_t95(kept - 1) * stats->stddev / sqrt((double) kept) : INFINITY;
+}
+
+static inline size_t bench_env_size(const char *name, size_t fallback) {
+    const char *value = getenv(name);
+    return value ? (size_t) strtoull(value, NULL, 10) : fallback;
+}
+
+static inline bench_config bench_make_config(size_t min_runs, size_t max_runs, double rel_ci) {
+    bench_config cfg;
+    const char *rel = getenv("BENCH_REL_CI");
+    cfg.min_runs = bench_env_size("BENCH_MIN_RUNS", min_runs);
+    cfg.max_runs = bench_env_size("BENCH_MAX_RUNS", max_runs);
+    cfg.rel_ci = rel ? atof(rel) : rel_ci;
+    if (cfg.min_runs == 0) {
+        cfg.min_runs = 1;
+    }
+    if (cfg.max_runs < cfg.min_runs) {
+        cfg.max_runs = cfg.min_runs;
+    }
+    return cfg;
+}
+
+/*
+ * Вызывает fn до сходимости доверительного интервала, каждый вызов даёт один
+ * отсчёт. Возвращает 0, если не хватило памяти под max_runs отсчётов
+ * (например, огромный BENCH_MAX_RUNS); stats тогда обнулена, runs == 0.
+ */
+static inline int bench_run(bench_fn fn, void *ctx, const bench_config *cfg, bench_stats *stats) {
+    double *samples = (double *) malloc(cfg->max_runs * sizeof(double));
+    double *sorted = (double *) malloc(cfg->max_runs * sizeof(double));
+    if (!samples || !sorted) {
+        fprintf(stderr, "bench: cannot allocate %zu samples\n", cfg->max_runs);
+        free(samples);
+        free(sorted);
+        memset(stats, 0, sizeof(*stats));
+        return 0;
+    }
+    size_t n = 0;
+    while (n < cfg->max_runs) {
+        samples[n++] = fn(ctx);
+        if (n < cfg->min_runs) {
+            continue;
+        }
+        memcpy(sorted, samples, n * sizeof(double));
+        bench_compute_stats(sorted, n, stats);
+        if (stats->median > 0 && stats->ci95 <= cfg->rel_ci * stats->median) {
+            break;
+        }
+    }
+    memcpy(sorted, samples, n * sizeof(double));
+    bench_compute_stats(sorted, n, stats);
+    free(samples);
+    free(sorted);
+    return 1;
+}
+
+static inline bench_report bench_report_open(const char *bench, const char *default_path) {
+    bench_report report;
+    const char *path = getenv("BENCH_OUTPUT");
+    if (!path) {
+        path = default_path;
+    }
+    size_t len = strlen(path);
+    report.json = len >= 5 && strcmp(path + len - 5, ".json") == 0;
+    report.bench = bench;
+    report.file = fopen(path, "a");
+    if (report.file && !report.json && ftell(report.file) == 0) {
+        fprintf(report.file, "bench,host,timestamp,tsc_ghz,case,param,unit,runs,outliers,"
+                             "min,p5,median,p95,max,mean,stddev,ci95\n");
+    }
+    return report;
+}
+
+static inline void bench_report_write(bench_report *report, const char *name, const char *param,
+                                      const char *unit, const bench_stats *stats) {
+    if (!report->file) {
+        return;
+    }
+    char host[64] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    long long timestamp = (long long) time(NULL);
+    if (report->json) {
+        fprintf(report->file,
+                "{\"bench\":\"%s\",\"host\":\"%s\",\"timestamp\":%lld,\"tsc_ghz\":%.4f,"
+                "\"case\":\"%s\",\"param\":\"%s\",\"unit\":\"%s\",\"runs\":%zu,\"outliers\":%zu,"
+                "\"min\":%.6g,\"p5\":%.6g,\"median\":%.6g,\"p95\":%.6g,\"max\":%.6g,"
+                "\"mean\":%.6g,\"stddev\":%.6g,\"ci95\":%.6g}\n",
+                report->bench, host, timestamp, bench_tsc_ghz(), name, param, unit,
+                stats->runs, stats->outliers, stats->min, stats->p5, stats->median, stats->p95,
+                stats->max, stats->mean, stats->stddev, stats->ci95);
+    } else {
+        fprintf(report->file, "%s,%s,%lld,%.4f,%s,%s,%s,%zu,%zu,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n",
+                report->bench, host, timestamp, bench_tsc_ghz(), name, param, unit,
+                stats->runs, stats->outliers, stats->min, stats->p5, stats->median, stats->p95,
+                stats->max, stats->mean, stats->stddev, stats->ci95);
+    }
+    fflush(report->file);
+}
+
+static inline void bench_report_close(bench_report *report) {
+    if (report->file) {
+        fclose(report->file);
+        report->file = NULL;
+    }
+}
+
+#endif
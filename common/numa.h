@@ -0,0 +1,181 @@
+#ifndef COMMON_NUMA_H
+#define COMMON_NUMA_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * NUMA-размещение без libnuma: узлы и их процессоры читаются из
+ * /sys/devices/system/node, память привязывается системным вызовом mbind.
+ * Если sysfs не содержит узлов, считается, что узел один (0) и все CPU его.
+ */
+
+#define NODE_MAX 64
+#define NODE_SYSFS "/sys/devices/system/node"
+#define NODE_MPOL_BIND 2
+#define NODE_MPOL_MF_STRICT 1
+#define NODE_MPOL_MF_MOVE 2
+#define NODE_HUGE_PAGE (2ul << 20)
+
+/* Разбирает список вида "0-3,8,10-11" и вызывает add(value, ctx) для каждого числа. */
+static inline void node_parse_list(const char *list, void (*add)(int, void *), void *ctx) {
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        long hi = lo;
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long v = lo; v <= hi; ++v) {
+            add((int) v, ctx);
+        }
+        while (*p == ',' || *p == '\n' || *p == ' ') {
+            ++p;
+        }
+    }
+}
+
+static inline int node_read_file(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return 0;
+    }
+    size_t n = fread(buf, 1, len - 1, f);
+    buf[n] = '\0';
+    fclose(f);
+    return n > 0;
+}
+
+typedef struct {
+    int *values;
+    int count;
+    int max;
+} node_list;
+
+static inline void node_list_add(int value, void *ctx) {
+    node_list *list = (node_list *) ctx;
+    if (list->count < list->max) {
+        list->values[list->count++] = value;
+    }
+}
+
+/* Заполняет nodes номерами online-узлов, возвращает их количество (не меньше 1). */
+static inline int node_list_online(int *nodes, int max) {
+    char buf[256];
+    node_list list = {nodes, 0, max};
+    if (node_read_file(NODE_SYSFS "/online", buf, sizeof(buf))) {
+        node_parse_list(buf, node_list_add, &list);
+    }
+    if (list.count == 0) {
+        nodes[0] = 0;
+        list.count = 1;
+    }
+    return list.count;
+}
+
+static inline void node_cpu_add(int cpu, void *ctx) {
+    if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, (cpu_set_t *) ctx);
+    }
+}
+
+static inline int node_cpus(int node, cpu_set_t *set) {
+    char path[128];
+    char buf[1024];
+    CPU_ZERO(set);
+    snprintf(path, sizeof(path), NODE_SYSFS "/node%d/cpulist", node);
+    if (node_read_file(path, buf, sizeof(buf))) {
+        node_parse_list(buf, node_cpu_add, set);
+    }
+    if (CPU_COUNT(set) == 0) {
+        return sched_getaffinity(0, sizeof(*set), set) == 0;
+    }
+    return 1;
+}
+
+/* Привязывает текущий поток к процессорам узла node. */
+static inline int node_bind_thread(int node) {
+    cpu_set_t set;
+    if (!node_cpus(node, &set)) {
+        return 0;
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+static inline void node_bind_range(void *p, size_t bytes, int node) {
+    if (node >= 0 && node < NODE_MAX) {
+        unsigned long mask[NODE_MAX / (8 * sizeof(unsigned long))];
+        memset(mask, 0, sizeof(mask));
+        mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+        if (syscall(SYS_mbind, p, bytes, NODE_MPOL_BIND, mask, NODE_MAX + 1,
+                    NODE_MPOL_MF_STRICT | NODE_MPOL_MF_MOVE) != 0) {
+            fprintf(stderr, "mbind to node %d failed, using default placement\n", node);
+        }
+    }
+}
+
+/*
+ * Выделяет bytes байт через mmap и привязывает их к узлу node до первого
+ * обращения. При node < 0 используется политика по умолчанию. Возвращает
+ * NULL при ошибке; неудачный mbind не считается ошибкой (например, ядро без NUMA).
+ */
+static inline void *node_alloc(size_t bytes, int node) {
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    node_bind_range(p, bytes, node);
+    return p;
+}
+
+/*
+ * Как node_alloc, но начало выровнено на 2M и область помечена
+ * MADV_HUGEPAGE, чтобы ядро отдало её прозрачными огромными страницами.
+ * Лишнее вокруг выровненной области сразу возвращается, поэтому
+ * освобождается она тем же node_free(p, bytes).
+ */
+static inline void *node_alloc_huge(size_t bytes, int node) {
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    const size_t span = bytes + NODE_HUGE_PAGE;
+    char *raw = (char *) mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    char *p = (char *) (((uintptr_t) raw + NODE_HUGE_PAGE - 1) & ~(uintptr_t) (NODE_HUGE_PAGE - 1));
+    size_t head = (size_t) (p - raw);
+    size_t length = (bytes + page - 1) / page * page;
+    if (head > 0) {
+        munmap(raw, head);
+    }
+    if (span - head > length) {
+        munmap(p + length, span - head - length);
+    }
+    if (madvise(p, length, MADV_HUGEPAGE) != 0) {
+        fprintf(stderr, "madvise(MADV_HUGEPAGE) failed, pages stay 4K\n");
+    }
+    node_bind_range(p, bytes, node);
+    return p;
+}
+
+static inline void node_free(void *p, size_t bytes) {
+    if (p) {
+        munmap(p, bytes);
+    }
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef COMMON_PERF_COUNTERS_H
+#define COMMON_PERF_COUNTERS_H
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cpuid.h>
+
+/*
+ * Аппаратные счётчики через perf_event_open для окон замера lab8, lab9, lab10.
+ * Включаются переменной окружения BENCH_PERF=1. Каждый счётчик открывается
+ * отдельно, поэтому недоступные (нет прав, нет события на этом CPU) просто
+ * выводятся как nan. Счётчик page walks зависит от модели: по умолчанию
+ * берётся DTLB_LOAD_MISSES.WALK_COMPLETED для Intel, другой raw-код можно
+ * задать через BENCH_PERF_WALK_RAW.
+ */
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_PAGE_WALKS,
+    PERF_EVENT_COUNT
+} perf_event_id;
+
+typedef struct {
+    int enabled;
+    int fd[PERF_EVENT_COUNT];
+    double total[PERF_EVENT_COUNT];
+} perf_counters;
+
+static inline const char *perf_event_name(int id) {
+    static const char *names[PERF_EVENT_COUNT] = {
+        "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "page_walks"
+    };
+    return names[id];
+}
+
+static inline uint64_t perf_cache_config(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+static inline int perf_is_intel(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    return ebx == 0x756e6547 && edx == 0x49656e69 && ecx == 0x6c65746e;
+}
+
+static inline int perf_open_event(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static inline void perf_counters_open(perf_counters *pc) {
+    memset(pc, 0, sizeof(*pc));
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+        pc->fd[i] = -1;
+    }
+    const char *env = getenv("BENCH_PERF");
+    if (!env || strcmp(env, "0") == 0) {
+        return;
+    }
+    pc->enabled = 1;
+    pc->fd[PERF_CYCLES] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    pc->fd[PERF_INSTRUCTIONS] = perf_open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    pc->fd[PERF_L1D_MISSES] = perf_open_event(PERF_TYPE_HW_CACHE,
+        perf_cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    pc->fd[PERF_LLC_MISSES] = perf_open_event(PERF_TYPE_HW_CACHE,
+        perf_cache_config(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    pc->fd[PERF_DTLB_MISSES] = perf_open_event(PERF_TYPE_HW_CACHE,
+        perf_cache_config(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    const char *walk = getenv("BENCH_PERF_WALK_RAW");
+    if (walk) {
+        pc->fd[PERF_PAGE_WALKS] = perf_open_event(PERF_TYPE_RAW, strtoull(walk, NULL, 0));
+    } else if (perf_is_intel()) {
+        pc->fd[PERF_PAGE_WALKS] = perf_open_event(PERF_TYPE_RAW, 0x0e08);
+    }
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+        if (pc->fd[i] < 0) {
+            fprintf(stderr, "perf: counter %s is unavailable\n", perf_event_name(i));
+        }
+    }
+}
+
+static inline void perf_counters_clear(perf_counters *pc) {
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+        pc->total[i] = 0;
+    }
+}
+
+static inline void perf_counters_start(perf_counters *pc) {
+    if (!pc || !pc->enabled) {
+        return;
+    }
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+        if (pc->fd[i] >= 0) {
+            ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+/* Останавливает счётчики и добавляет их значения (с поправкой на мультиплексирование) к total. */
+static inline void perf_counters_stop(perf_counters *pc) {
+    if (!pc || !pc->enabled) {
+        return;
+    }
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+        if (pc->fd[i] >= 0) {
+            ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+        uint64_t data[3];
+        if (pc->fd[i] < 0 || read(pc->fd[i], data, sizeof(data)) != (ssize_t) sizeof(data)) {
+            continue;
+        }
+        double scale = data[2] > 0 ? (double) data[1] / (double) data[2] : 1.0;
+        pc->total[i] += (double) data[0] * scale;
+    }
+}
+
+static inline void perf_counters_close(perf_counters *pc) {
+    for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+        if (pc->fd[i] >= 0) {
+            close(pc->fd[i]);
+            pc->fd[i] = -1;
+        }
+    }
+    pc->enabled = 0;
+}
+
+/* Дописывает в buf заголовки колонок вида "<sep><prefix><event>". */
+static inline void perf_counters_header(const perf_counters *pc, const char *prefix, char sep,
+                                        char *buf, size_t len) {
+    buf[0] = '\0';
+    if (!pc->enabled) {
+        return;
+    }
+    size_t used = 0;
+    for (int i = 0; i < PERF_EVENT_COUNT && used < len; ++i) {
+        used += snprintf(buf + used, len - used, "%c%s%s", sep, prefix, perf_event_name(i));
+    }
+}
+
+/* Дописывает в buf значения счётчиков, делённые на число обращений accesses. */
+static inline void perf_counters_values(const perf_counters *pc, double accesses, char sep,
+                                        char *buf, size_t len) {
+    buf[0] = '\0';
+    if (!pc->enabled) {
+        return;
+    }
+    size_t used = 0;
+    for (int i = 0; i < PERF_EVENT_COUNT && used < len; ++i) {
+        if (pc->fd[i] >= 0 && accesses > 0) {
+            used += snprintf(buf + used, len - used, "%c%.4f", sep, pc->total[i] / accesses);
+        } else {
+            used += snprintf(buf + used, len - used, "%cnan", sep);
+        }
+    }
+}
+
+#endif
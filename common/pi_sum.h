@@ -0,0 +1,131 @@
+#ifndef COMMON_PI_SUM_H
+#define COMMON_PI_SUM_H
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#define PI_REFERENCE 3.14159265358979323846264338327950288L
+#define PAIRWISE_BLOCK 128
+
+typedef enum {
+    PI_NAIVE,
+    PI_KAHAN,
+    PI_NEUMAIER,
+    PI_PAIRWISE,
+    PI_EULER,
+    PI_MODE_COUNT
+} pi_mode;
+
+static inline const char *pi_mode_name(pi_mode mode) {
+    switch (mode) {
+        case PI_NAIVE: return "naive";
+        case PI_KAHAN: return "kahan";
+        case PI_NEUMAIER: return "neumaier";
+        case PI_PAIRWISE: return "pairwise";
+        case PI_EULER: return "euler";
+        default: return "unknown";
+    }
+}
+
+static inline pi_mode pi_mode_from_name(const char *name) {
+    for (int mode = 0; mode < PI_MODE_COUNT; ++mode) {
+        if (strcmp(name, pi_mode_name((pi_mode) mode)) == 0) {
+            return (pi_mode) mode;
+        }
+    }
+    return PI_MODE_COUNT;
+}
+
+static inline double leibniz_naive(const size_t N) {
+    double sum = 0;
+    int sign = 1;
+    for (size_t i = 0; i < N; ++i) {
+        sum += (double) sign / (2 * i + 1);
+        sign = -sign;
+    }
+    return sum;
+}
+
+static inline double leibniz_kahan(const size_t N) {
+    double sum = 0;
+    double c = 0;
+    int sign = 1;
+    for (size_t i = 0; i < N; ++i) {
+        double y = (double) sign / (2 * i + 1) - c;
+        double t = sum + y;
+        c = (t - sum) - y;
+        sum = t;
+        sign = -sign;
+    }
+    return sum;
+}
+
+static inline double leibniz_neumaier(const size_t N) {
+    double sum = 0;
+    double c = 0;
+    int sign = 1;
+    for (size_t i = 0; i < N; ++i) {
+        double term = (double) sign / (2 * i + 1);
+        double t = sum + term;
+        if (fabs(sum) >= fabs(term)) {
+            c += (sum - t) + term;
+        } else {
+            c += (term - t) + sum;
+        }
+        sum = t;
+        sign = -sign;
+    }
+    return sum + c;
+}
+
+static inline double leibniz_pairwise(const size_t begin, const size_t end) {
+    if (end - begin <= PAIRWISE_BLOCK) {
+        double sum = 0;
+        int sign = (begin % 2 == 0) ? 1 : -1;
+        for (size_t i = begin; i < end; ++i) {
+            sum += (double) sign / (2 * i + 1);
+            sign = -sign;
+        }
+        return sum;
+    }
+    size_t mid = begin + (end - begin) / 2;
+    return leibniz_pairwise(begin, mid) + leibniz_pairwise(mid, end);
+}
+
+/*
+ * Преобразование Эйлера ряда Лейбница: pi/2 = sum n! / (2n+1)!!.
+ * Каждый член меньше предыдущего примерно вдвое, поэтому
+ * для полной точности double хватает ~50 членов, а примерно через
+ * 1100 член становится нулём - дальше N не влияет ни на сумму, ни на время.
+ */
+static inline double leibniz_euler(const size_t N) {
+    double sum = 0;
+    double term = 1;
+    for (size_t n = 0; n < N && term != 0; ++n) {
+        sum += term;
+        term *= (double) (n + 1) / (2 * n + 3);
+    }
+    return sum / 2;
+}
+
+static inline double calculate_pi(const size_t N, const pi_mode mode) {
+    switch (mode) {
+        case PI_KAHAN: return 4 * leibniz_kahan(N);
+        case PI_NEUMAIER: return 4 * leibniz_neumaier(N);
+        case PI_PAIRWISE: return N == 0 ? 0 : 4 * leibniz_pairwise(0, N);
+        case PI_EULER: return 4 * leibniz_euler(N);
+        default: return 4 * leibniz_naive(N);
+    }
+}
+
+/* Число верных десятичных знаков относительно PI_REFERENCE. */
+static inline double pi_digits(const double pi) {
+    long double err = fabsl((long double) pi - PI_REFERENCE);
+    if (err == 0) {
+        return 17;
+    }
+    return (double) -log10l(err / PI_REFERENCE);
+}
+
+#endif
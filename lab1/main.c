@@ -1,19 +1,31 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../common/pi_sum.h"
 
-double calculate_pi(const size_t N) {
-    double sum = 0;
-    int sign = 1;
-    for (size_t i = 0; i < N; ++i) {
-        sum += (double) sign / (2 * i + 1);
-        sign = -sign;
-    }
-    return 4 * sum;
-}
+#define MAX_TERMS 1000000000
 
-int main(void) {
+int main(int argc, char **argv) {
     size_t N = 100;
-    double pi = calculate_pi(N);
+    double pi = calculate_pi(N, PI_NAIVE);
     printf("Число пи: %.10f\n", pi);
+
+    double target = argc > 1 ? atof(argv[1]) : 10;
+    printf("\nЦель: %.1f верных знаков\n", target);
+    printf("%-10s %12s %20s %8s %14s\n", "Режим", "N", "Число пи", "Знаков", "нс/член");
+    for (int mode = 0; mode < PI_MODE_COUNT; ++mode) {
+        for (N = 10; N <= MAX_TERMS; N *= 10) {
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+            pi = calculate_pi(N, (pi_mode) mode);
+            clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+            double ns = 1e9 * (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec);
+            double digits = pi_digits(pi);
+            printf("%-10s %12zu %20.15f %8.2f %14.3f\n", pi_mode_name((pi_mode) mode), N, pi, digits, ns / N);
+            if (digits >= target) {
+                break;
+            }
+        }
+    }
     return 0;
 }
-
@@ -1,20 +1,61 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <sys/mman.h>
 #include <x86intrin.h>
+#include "../common/bench.h"
+#include "../common/perf_counters.h"
 
 #define PAGE_SIZE 4096
+#define HUGE_PAGE_2M (2UL * 1024 * 1024)
+#define HUGE_PAGE_1G (1024UL * 1024 * 1024)
 #define CACHE_LINE 64
-#define STRIDE (PAGE_SIZE + CACHE_LINE)
 #define MAX_ENTRIES 8192
 #define ITERATIONS 1000000
 #define REPEAT_COUNT 100
 #define STRIDE_MULTIPLIER 4
+#define THP_ENTRIES 512
+#define HUGETLB_2M_ENTRIES 1024
+#define HUGETLB_1G_ENTRIES 32
 
-static inline uint64_t read_tsc(void) {
-    return __rdtsc();
-}
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+typedef enum {
+    PAGES_4K,
+    PAGES_THP,
+    PAGES_2M,
+    PAGES_1G,
+    PAGE_MODE_COUNT
+} page_mode;
+
+static const char *page_mode_names[PAGE_MODE_COUNT] = {"4k", "thp", "2m", "1g"};
+
+/*
+ * Область, в которой каждая запись цепочки лежит на своей странице.
+ * Шаг между записями - размер страницы плюс строка кэша, чтобы записи
+ * не попадали в одно множество кэша; для 4K-страниц дополнительно
+ * используется каждая STRIDE_MULTIPLIER-я страница, как и раньше.
+ */
+typedef struct {
+    page_mode mode;
+    size_t page_size;
+    size_t stride;
+    int stride_multiplier;
+    int max_entries;
+    size_t total_size;
+    void *buffer;
+    void **pages;
+} page_region;
 
 void flush_cache(void *addr, size_t size) {
     const size_t FLUSH_SIZE = 12 * 1024 * 1024;
@@ -29,8 +70,9 @@ void flush_cache(void *addr, size_t size) {
 }
 
 
-double measure_single_run(void **pages, int entries, int iterations, int stride_multiplier) {
-    int effective_stride = stride_multiplier * STRIDE;
+double measure_single_run(void **pages, int entries, int iterations, int stride_multiplier, size_t stride,
+                          perf_counters *perf) {
+    size_t effective_stride = stride_multiplier * stride;
 
     for (int i = 0; i < entries - 1; ++i) {
         int next_idx = (i + 1) % entries;
@@ -45,61 +87,285 @@ double measure_single_run(void **pages, int entries, int iterations, int stride_
 
     flush_cache(pages[0], entries * effective_stride);
 
-    uint64_t start = read_tsc();
+    perf_counters_start(perf);
+    uint64_t start = bench_cycles_begin();
 
     for (int i = 0; i < iterations; ++i) {
         ptr = *(void **)ptr;
     }
     __asm__ __volatile__("" : : "r"(ptr));
-    uint64_t end = read_tsc();
+    uint64_t end = bench_cycles_end();
+    perf_counters_stop(perf);
 
     uint64_t total_cycles = end - start;
     return (double)total_cycles / iterations;
 }
 
 
-void measure_tlb(void **pages, int entries, int stride_multiplier) {
-    double min_cycles = 1e9;
+typedef struct {
+    const page_region *region;
+    int entries;
+    perf_counters *perf;
+} tlb_run;
+
+static double tlb_sample(void *ctx) {
+    tlb_run *run = (tlb_run *)ctx;
+    return measure_single_run(run->region->pages, run->entries, ITERATIONS, run->region->stride_multiplier,
+                              run->region->stride, run->perf);
+}
+
+double measure_tlb(const page_region *region, int entries, const bench_config *cfg, bench_report *report,
+                   perf_counters *perf) {
+    tlb_run run = {region, entries, perf};
+    bench_stats stats;
+    char name[16];
+    char param[16];
+    char counters[512];
     printf("%d\t", entries);
     fflush(stdout);
-    for (int i = 0; i < REPEAT_COUNT; ++i) {
-        double cycles = measure_single_run(pages, entries, ITERATIONS, stride_multiplier);
-        if (cycles < min_cycles) {
-            min_cycles = cycles;
+    perf_counters_clear(perf);
+    bench_run(tlb_sample, &run, cfg, &stats);
+    snprintf(name, sizeof(name), "tlb/%s", page_mode_names[region->mode]);
+    snprintf(param, sizeof(param), "%d", entries);
+    bench_report_write(report, name, param, "cycles", &stats);
+    perf_counters_values(perf, (double)ITERATIONS * stats.runs, '\t', counters, sizeof(counters));
+    printf("%.2f\t%.2f\t%.2f%s\n", stats.median, stats.p5, stats.p95, counters);
+    return stats.median;
+}
+
+/*
+ * Мелкий шаг в начале: уровни TLB для 2M и 1G страниц - единицы и десятки
+ * записей. Для 4K остаётся прежняя сетка 8, 16, 24, ..., чтобы результаты
+ * совпадали по точкам с более ранними замерами; она входит в мелкую сетку,
+ * так что общая таблица идёт по мелкой.
+ */
+int first_entries(page_mode mode) {
+    return mode == PAGES_4K ? 8 : 1;
+}
+
+int next_entries(page_mode mode, int entries) {
+    if (mode != PAGES_4K && entries < 16) {
+        return entries + 1;
+    }
+    if (mode != PAGES_4K && entries < 64) {
+        return entries + 4;
+    }
+    return entries < 256 ? entries + 8 : (entries == 256 ? 272 : entries + 16);
+}
+
+/* Свободные зарезервированные страницы hugetlbfs размера page_size, -1 если неизвестно. */
+static long free_hugepages(size_t page_size) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/kernel/mm/hugepages/hugepages-%zukB/free_hugepages", page_size >> 10);
+    FILE *f = fopen(path, "r");
+    long pages = -1;
+    if (f) {
+        if (fscanf(f, "%ld", &pages) != 1) {
+            pages = -1;
         }
+        fclose(f);
     }
+    return pages;
+}
 
-    printf("%.2f\n", min_cycles);
+/*
+ * Предел числа записей для режима: 4K - MAX_ENTRIES, thp - THP_ENTRIES
+ * (1 ГБ), 2m и 1g - не больше зарезервированных свободных страниц (запись
+ * со сдвигом на строку кэша задевает следующую страницу, поэтому на одну
+ * страницу меньше). budget, если не 0, ограничивает объём сверху.
+ */
+static int entry_limit(page_mode mode, size_t per_entry, size_t page_size, size_t budget) {
+    long limit = mode == PAGES_4K ? MAX_ENTRIES
+               : mode == PAGES_THP ? THP_ENTRIES
+               : mode == PAGES_2M ? HUGETLB_2M_ENTRIES : HUGETLB_1G_ENTRIES;
+    if (mode == PAGES_2M || mode == PAGES_1G) {
+        long pages = free_hugepages(page_size);
+        if (pages >= 0 && pages - 1 < limit) {
+            limit = pages - 1;
+        }
+    }
+    if (budget > 0 && (long)(budget / per_entry) < limit) {
+        limit = (long)(budget / per_entry);
+    }
+    return limit < 0 ? 0 : (int)limit;
 }
 
-int main() {
-    printf("Entries\tTicks\n");
-    printf("-------\t------\n");
+static void *map_region(size_t size, int flags) {
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
 
-    size_t total_size = MAX_ENTRIES * STRIDE_MULTIPLIER * STRIDE;
-    void *buffer;
+/*
+ * Выделяет и заполняет область для режима mode (budget - предел в байтах, 0 - по умолчанию).
+ * Для thp память выравнивается на 2M и помечается MADV_HUGEPAGE,
+ * для 2m и 1g используется MAP_HUGETLB (нужны зарезервированные страницы
+ * в /proc/sys/vm/nr_hugepages или hugepages-1048576kB).
+ */
+int region_alloc(page_region *region, page_mode mode, size_t budget) {
+    memset(region, 0, sizeof(*region));
+    region->mode = mode;
+    region->page_size = mode == PAGES_4K ? PAGE_SIZE : (mode == PAGES_1G ? HUGE_PAGE_1G : HUGE_PAGE_2M);
+    region->stride = region->page_size + CACHE_LINE;
+    region->stride_multiplier = mode == PAGES_4K ? STRIDE_MULTIPLIER : 1;
+    size_t per_entry = region->stride_multiplier * region->stride;
+    region->max_entries = entry_limit(mode, per_entry, region->page_size, budget);
+    if (region->max_entries < first_entries(mode)) {
+        fprintf(stderr, "%s: not enough memory for %d entries (budget or reserved huge pages)\n",
+                page_mode_names[mode], first_entries(mode));
+        return 0;
+    }
+    size_t count = (size_t)region->max_entries * region->stride_multiplier;
+    region->total_size = (count * region->stride + region->page_size - 1) / region->page_size * region->page_size;
 
-    if (posix_memalign(&buffer, PAGE_SIZE, total_size) != 0) {
-        fprintf(stderr, "Memory allocation failed\n");
-        return 1;
+    switch (mode) {
+        case PAGES_4K:
+            if (posix_memalign(&region->buffer, PAGE_SIZE, region->total_size) != 0) {
+                region->buffer = NULL;
+            }
+            break;
+        case PAGES_THP:
+            if (posix_memalign(&region->buffer, HUGE_PAGE_2M, region->total_size) != 0) {
+                region->buffer = NULL;
+            } else if (madvise(region->buffer, region->total_size, MADV_HUGEPAGE) != 0) {
+                fprintf(stderr, "thp: madvise(MADV_HUGEPAGE) failed, pages may stay 4K\n");
+            }
+            break;
+        case PAGES_2M:
+            region->buffer = map_region(region->total_size, MAP_HUGETLB | MAP_HUGE_2MB);
+            break;
+        case PAGES_1G:
+            region->buffer = map_region(region->total_size, MAP_HUGETLB | MAP_HUGE_1GB);
+            break;
+        default:
+            break;
     }
+    if (!region->buffer) {
+        fprintf(stderr, "%s: allocation of %zu MB failed\n", page_mode_names[mode], region->total_size >> 20);
+        return 0;
+    }
+    // Достаточно коснуться каждой 4K-страницы, чтобы она была выделена заранее.
+    for (size_t off = 0; off < region->total_size; off += PAGE_SIZE) {
+        ((volatile char *)region->buffer)[off] = 0;
+    }
+    region->pages = (void **)malloc(count * sizeof(void *));
+    if (!region->pages) {
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        region->pages[i] = (char *)region->buffer + i * region->stride;
+    }
+    return 1;
+}
 
-    memset(buffer, 0, total_size);
-    void **pages = (void **)malloc(MAX_ENTRIES * STRIDE_MULTIPLIER * sizeof(void *));
-    if (!pages) {
-        free(buffer);
-        return 1;
+void region_free(page_region *region) {
+    if (region->buffer) {
+        if (region->mode == PAGES_2M || region->mode == PAGES_1G) {
+            munmap(region->buffer, region->total_size);
+        } else {
+            free(region->buffer);
+        }
     }
-    for (int i = 0; i < MAX_ENTRIES * STRIDE_MULTIPLIER; i++) {
-        pages[i] = (char *)buffer + i * STRIDE;
+    free(region->pages);
+    region->buffer = NULL;
+    region->pages = NULL;
+}
+
+/* Разбирает список режимов вида "4k,thp,2m"; возвращает число выбранных режимов. */
+int parse_page_modes(const char *list, int *selected) {
+    int count = 0;
+    char buf[64];
+    strncpy(buf, list, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        for (int m = 0; m < PAGE_MODE_COUNT; ++m) {
+            if (strcmp(tok, page_mode_names[m]) == 0 && !selected[m]) {
+                selected[m] = 1;
+                ++count;
+            }
+        }
     }
-    for (int entries = 8; entries <= 256; entries += 8) {
-        measure_tlb(pages, entries, STRIDE_MULTIPLIER);
+    return count;
+}
+
+int main(int argc, char **argv) {
+    int selected[PAGE_MODE_COUNT] = {0};
+    int mode_count = 0;
+    size_t budget = 0;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--pages") == 0) {
+            mode_count = parse_page_modes(argv[++i], selected);
+        } else if (strcmp(argv[i], "--max-mb") == 0) {
+            budget = strtoull(argv[++i], NULL, 10) << 20;
+        }
     }
-    for (int entries = 272; entries <= MAX_ENTRIES; entries += 16) {
-        measure_tlb(pages, entries, STRIDE_MULTIPLIER);
+    if (mode_count == 0) {
+        selected[PAGES_4K] = 1;
+        mode_count = 1;
+    }
+
+    perf_counters perf;
+    char header[512];
+    perf_counters_open(&perf);
+    perf_counters_header(&perf, "", '\t', header, sizeof(header));
+    bench_config cfg = bench_make_config(10, REPEAT_COUNT, 0.01);
+    bench_report report = bench_report_open("lab10", "bench.csv");
+
+    static double curves[PAGE_MODE_COUNT][MAX_ENTRIES + 1];
+    static char measured[PAGE_MODE_COUNT][MAX_ENTRIES + 1];
+    for (int m = 0; m < PAGE_MODE_COUNT; ++m) {
+        if (!selected[m]) {
+            continue;
+        }
+        page_region region;
+        if (!region_alloc(&region, (page_mode)m, budget)) {
+            region_free(&region);
+            selected[m] = 0;
+            continue;
+        }
+        if (mode_count > 1) {
+            printf("\nPages: %s (%zu bytes), stride %zu, up to %d entries\n", page_mode_names[m],
+                   region.page_size, region.stride * region.stride_multiplier, region.max_entries);
+        }
+        printf("Entries\tTicks\tP5\tP95%s\n", header);
+        printf("-------\t------\t------\t------\n");
+        for (int entries = first_entries((page_mode)m); entries <= region.max_entries; entries = next_entries((page_mode)m, entries)) {
+            curves[m][entries] = measure_tlb(&region, entries, &cfg, &report, &perf);
+            measured[m][entries] = 1;
+        }
+        region_free(&region);
+    }
+
+    if (mode_count > 1) {
+        printf("\nEntries");
+        for (int m = 0; m < PAGE_MODE_COUNT; ++m) {
+            if (selected[m]) {
+                printf("\t%s", page_mode_names[m]);
+            }
+        }
+        printf("\n");
+        for (int entries = 1; entries <= MAX_ENTRIES; entries = next_entries(PAGES_THP, entries)) {
+            int any = 0;
+            for (int m = 0; m < PAGE_MODE_COUNT; ++m) {
+                any |= selected[m] && measured[m][entries];
+            }
+            if (!any) {
+                continue;
+            }
+            printf("%d", entries);
+            for (int m = 0; m < PAGE_MODE_COUNT; ++m) {
+                if (!selected[m]) {
+                    continue;
+                }
+                if (measured[m][entries]) {
+                    printf("\t%.2f", curves[m][entries]);
+                } else {
+                    printf("\t-");
+                }
+            }
+            printf("\n");
+        }
     }
-    free(pages);
-    free(buffer);
+    bench_report_close(&report);
+    perf_counters_close(&perf);
     return 0;
 }
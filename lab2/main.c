@@ -1,29 +1,285 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
-#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <immintrin.h>
+#include "../common/bench.h"
+#include "../common/pi_sum.h"
 
 #define NUMBER_OF_TESTS 3
+#define MAX_THREADS 256
 
-double calculate_pi(const size_t N){
+typedef enum {
+        ISA_SCALAR,
+        ISA_AVX2,
+        ISA_AVX512
+} isa_t;
+
+typedef struct {
+        size_t begin;
+        size_t end;
+        int cpu;
+        isa_t isa;
+        double sum;
+        double time;
+} pi_task;
+
+/*
+ * Члены ряда берутся парами: 1/(4p+1) - 1/(4p+3) = 2/((4p+1)(4p+3)),
+ * поэтому знак не чередуется и на пару приходится одно деление.
+ * Функции ниже суммируют пары с индексами [begin, end).
+ */
+static double pairs_scalar(size_t begin, size_t end){
+        double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        size_t p = begin;
+        for (; p + 3 < end; p += 4){
+                double d = 4.0 * p;
+                s0 += 2.0 / ((d + 1) * (d + 3));
+                s1 += 2.0 / ((d + 5) * (d + 7));
+                s2 += 2.0 / ((d + 9) * (d + 11));
+                s3 += 2.0 / ((d + 13) * (d + 15));
+        }
+        for (; p < end; ++p){
+                double d = 4.0 * p;
+                s0 += 2.0 / ((d + 1) * (d + 3));
+        }
+        return (s0 + s1) + (s2 + s3);
+}
+
+__attribute__((target("avx2,fma")))
+static double pairs_avx2(size_t begin, size_t end){
+        const __m256d one = _mm256_set1_pd(1.0);
+        const __m256d three = _mm256_set1_pd(3.0);
+        const __m256d two = _mm256_set1_pd(2.0);
+        const __m256d four = _mm256_set1_pd(4.0);
+        const __m256d step = _mm256_set1_pd(16.0);
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        __m256d acc2 = _mm256_setzero_pd();
+        __m256d acc3 = _mm256_setzero_pd();
+        double base = (double)begin;
+        __m256d p0 = _mm256_add_pd(_mm256_set1_pd(base), _mm256_setr_pd(0, 1, 2, 3));
+        __m256d p1 = _mm256_add_pd(p0, four);
+        __m256d p2 = _mm256_add_pd(p1, four);
+        __m256d p3 = _mm256_add_pd(p2, four);
+        size_t p = begin;
+        for (; p + 15 < end; p += 16){
+                __m256d d0 = _mm256_mul_pd(p0, four);
+                __m256d d1 = _mm256_mul_pd(p1, four);
+                __m256d d2 = _mm256_mul_pd(p2, four);
+                __m256d d3 = _mm256_mul_pd(p3, four);
+                acc0 = _mm256_add_pd(acc0, _mm256_div_pd(two, _mm256_mul_pd(_mm256_add_pd(d0, one), _mm256_add_pd(d0, three))));
+                acc1 = _mm256_add_pd(acc1, _mm256_div_pd(two, _mm256_mul_pd(_mm256_add_pd(d1, one), _mm256_add_pd(d1, three))));
+                acc2 = _mm256_add_pd(acc2, _mm256_div_pd(two, _mm256_mul_pd(_mm256_add_pd(d2, one), _mm256_add_pd(d2, three))));
+                acc3 = _mm256_add_pd(acc3, _mm256_div_pd(two, _mm256_mul_pd(_mm256_add_pd(d3, one), _mm256_add_pd(d3, three))));
+                p0 = _mm256_add_pd(p0, step);
+                p1 = _mm256_add_pd(p1, step);
+                p2 = _mm256_add_pd(p2, step);
+                p3 = _mm256_add_pd(p3, step);
+        }
+        __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+        double lanes[4];
+        _mm256_storeu_pd(lanes, acc);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + pairs_scalar(p, end);
+}
+
+__attribute__((target("avx512f")))
+static double pairs_avx512(size_t begin, size_t end){
+        const __m512d one = _mm512_set1_pd(1.0);
+        const __m512d three = _mm512_set1_pd(3.0);
+        const __m512d two = _mm512_set1_pd(2.0);
+        const __m512d four = _mm512_set1_pd(4.0);
+        const __m512d eight = _mm512_set1_pd(8.0);
+        const __m512d step = _mm512_set1_pd(32.0);
+        __m512d acc0 = _mm512_setzero_pd();
+        __m512d acc1 = _mm512_setzero_pd();
+        __m512d acc2 = _mm512_setzero_pd();
+        __m512d acc3 = _mm512_setzero_pd();
+        double base = (double)begin;
+        __m512d p0 = _mm512_add_pd(_mm512_set1_pd(base), _mm512_setr_pd(0, 1, 2, 3, 4, 5, 6, 7));
+        __m512d p1 = _mm512_add_pd(p0, eight);
+        __m512d p2 = _mm512_add_pd(p1, eight);
+        __m512d p3 = _mm512_add_pd(p2, eight);
+        size_t p = begin;
+        for (; p + 31 < end; p += 32){
+                __m512d d0 = _mm512_mul_pd(p0, four);
+                __m512d d1 = _mm512_mul_pd(p1, four);
+                __m512d d2 = _mm512_mul_pd(p2, four);
+                __m512d d3 = _mm512_mul_pd(p3, four);
+                acc0 = _mm512_add_pd(acc0, _mm512_div_pd(two, _mm512_mul_pd(_mm512_add_pd(d0, one), _mm512_add_pd(d0, three))));
+                acc1 = _mm512_add_pd(acc1, _mm512_div_pd(two, _mm512_mul_pd(_mm512_add_pd(d1, one), _mm512_add_pd(d1, three))));
+                acc2 = _mm512_add_pd(acc2, _mm512_div_pd(two, _mm512_mul_pd(_mm512_add_pd(d2, one), _mm512_add_pd(d2, three))));
+                acc3 = _mm512_add_pd(acc3, _mm512_div_pd(two, _mm512_mul_pd(_mm512_add_pd(d3, one), _mm512_add_pd(d3, three))));
+                p0 = _mm512_add_pd(p0, step);
+                p1 = _mm512_add_pd(p1, step);
+                p2 = _mm512_add_pd(p2, step);
+                p3 = _mm512_add_pd(p3, step);
+        }
+        __m512d acc = _mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3));
+        return _mm512_reduce_add_pd(acc) + pairs_scalar(p, end);
+}
+
+static isa_t detect_isa(void){
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")){
+                return ISA_AVX512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+                return ISA_AVX2;
+        }
+        return ISA_SCALAR;
+}
+
+static const char *isa_name(isa_t isa){
+        switch (isa){
+                case ISA_AVX512: return "avx512";
+                case ISA_AVX2: return "avx2";
+                default: return "scalar";
+        }
+}
+
+static void *pi_worker(void *arg){
+        pi_task *task = (pi_task *)arg;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(task->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+        uint64_t start = bench_now_ns();
+        switch (task->isa){
+                case ISA_AVX512: task->sum = pairs_avx512(task->begin, task->end); break;
+                case ISA_AVX2: task->sum = pairs_avx2(task->begin, task->end); break;
+                default: task->sum = pairs_scalar(task->begin, task->end); break;
+        }
+        task->time = 1e-9 * (bench_now_ns() - start);
+        return NULL;
+}
+
+/*
+ * Делит N членов ряда на threads потоков, каждый поток закреплён за своим ядром.
+ * При нечётном N последний (положительный) член добавляется отдельно.
+ */
+double calculate_pi_parallel(const size_t N, const int threads, const isa_t isa, pi_task *tasks){
+        pthread_t ids[MAX_THREADS];
+        const size_t pairs = N / 2;
+        const size_t chunk = pairs / threads;
+        const int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        for (int t = 0; t < threads; ++t){
+                tasks[t].begin = t * chunk;
+                tasks[t].end = (t == threads - 1) ? pairs : (t + 1) * chunk;
+                tasks[t].cpu = t % cpus;
+                tasks[t].isa = isa;
+                pthread_create(&ids[t], NULL, pi_worker, &tasks[t]);
+        }
         double sum = 0;
-        int sign = 1;
-        for (size_t i = 0; i < N; ++i){
-                sum += (double)sign / (2 * i + 1);
-                sign = -sign;
+        for (int t = 0; t < threads; ++t){
+                pthread_join(ids[t], NULL);
+                sum += tasks[t].sum;
+        }
+        if (N % 2 == 1){
+                sum += 1.0 / (2 * (N - 1) + 1);
         }
         return 4 * sum;
 }
 
-int main(void){
-        size_t arr[NUMBER_OF_TESTS] = {3500000000, 4500000000, 6000000000};
-        struct timespec start, end;
+static isa_t parse_isa(const char *name, isa_t fallback){
+        if (strcmp(name, "scalar") == 0) return ISA_SCALAR;
+        if (strcmp(name, "avx2") == 0) return ISA_AVX2;
+        if (strcmp(name, "avx512") == 0) return ISA_AVX512;
+        return fallback;
+}
+
+typedef struct {
+        size_t N;
+        pi_mode mode;
+        int threads;
+        isa_t isa;
+        pi_task *tasks;
         double result;
-        double time_taken;
+} pi_run;
+
+static double run_single(void *arg){
+        pi_run *run = (pi_run *)arg;
+        uint64_t start = bench_now_ns();
+        run->result = calculate_pi(run->N, run->mode);
+        return 1e-9 * (bench_now_ns() - start);
+}
+
+static double run_parallel(void *arg){
+        pi_run *run = (pi_run *)arg;
+        uint64_t start = bench_now_ns();
+        run->result = calculate_pi_parallel(run->N, run->threads, run->isa, run->tasks);
+        return 1e-9 * (bench_now_ns() - start);
+}
+
+static int next_thread_count(int threads, int max_threads){
+        if (threads < max_threads && threads * 2 > max_threads){
+                return max_threads;
+        }
+        return threads * 2;
+}
+
+int main(int argc, char **argv){
+        size_t arr[NUMBER_OF_TESTS] = {3500000000, 4500000000, 6000000000};
+        int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        isa_t isa = detect_isa();
+        pi_mode mode = PI_NAIVE;
+        if (argc > 1){
+                max_threads = atoi(argv[1]);
+        }
+        if (argc > 2){
+                isa_t requested = parse_isa(argv[2], isa);
+                if (requested > isa){
+                        fprintf(stderr, "Набор инструкций %s не поддерживается, используется %s\n", argv[2], isa_name(isa));
+                }
+                else {
+                        isa = requested;
+                }
+        }
+        if (argc > 3){
+                mode = pi_mode_from_name(argv[3]);
+                if (mode == PI_MODE_COUNT){
+                        fprintf(stderr, "Неизвестный режим суммирования: %s\n", argv[3]);
+                        return 1;
+                }
+        }
+        if (max_threads < 1 || max_threads > MAX_THREADS){
+                fprintf(stderr, "Число потоков должно быть от 1 до %d\n", MAX_THREADS);
+                return 1;
+        }
+
+        pi_task tasks[MAX_THREADS];
+        bench_config cfg = bench_make_config(3, 10, 0.02);
+        bench_report report = bench_report_open("lab2", "bench.csv");
+        bench_stats stats;
+        char param[32];
+        char name[64];
         for (size_t i = 0; i < NUMBER_OF_TESTS; ++i){
-                clock_gettime(CLOCK_MONOTONIC_RAW, &start);
-                result = calculate_pi(arr[i]);
-                clock_gettime(CLOCK_MONOTONIC_RAW, &end);
-                time_taken =  end.tv_sec - start.tv_sec + 1e-9*(end.tv_nsec - start.tv_nsec);
-                printf("N = %zu, Число Пи: %.15f, time = %f\n", arr[i], result, time_taken);
+                pi_run run = {arr[i], mode, 1, isa, tasks, 0};
+                snprintf(param, sizeof(param), "%zu", arr[i]);
+                bench_run(run_single, &run, &cfg, &stats);
+                snprintf(name, sizeof(name), "single/%s", pi_mode_name(mode));
+                bench_report_write(&report, name, param, "s", &stats);
+                printf("N = %zu, %s, Число Пи: %.15f, знаков = %.2f, time = %f (p5 %f, p95 %f, повторов %zu), нс/член = %.3f\n",
+                       arr[i], pi_mode_name(mode), run.result, pi_digits(run.result), stats.median, stats.p5, stats.p95,
+                       stats.runs, 1e9 * stats.median / arr[i]);
+
+                for (int threads = 1; threads <= max_threads; threads = next_thread_count(threads, max_threads)){
+                        run.threads = threads;
+                        bench_run(run_parallel, &run, &cfg, &stats);
+                        snprintf(name, sizeof(name), "parallel/%s/%d", isa_name(isa), threads);
+                        bench_report_write(&report, name, param, "s", &stats);
+                        printf("    %s, потоков = %d, Число Пи: %.15f, знаков = %.2f, time = %f (p5 %f, p95 %f, повторов %zu), членов/с = %.3e\n",
+                               isa_name(isa), threads, run.result, pi_digits(run.result), stats.median, stats.p5, stats.p95,
+                               stats.runs, arr[i] / stats.median);
+                        for (int t = 0; t < threads; ++t){
+                                printf("        поток %d (cpu %d): time = %f\n", t, tasks[t].cpu, tasks[t].time);
+                        }
+                }
         }
+        bench_report_close(&report);
         return 0;
 }
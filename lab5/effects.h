@@ -0,0 +1,357 @@
+#ifndef LAB5_EFFECTS_H
+#define LAB5_EFFECTS_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <immintrin.h>
+#include <opencv2/opencv.hpp>
+
+/*
+ * Эффекты над кадром BGR без лишних проходов и выделений памяти.
+ *
+ * Яркость считается в фиксированной точке: Y = (29 B + 150 G + 77 R + 128) >> 8
+ * (коэффициенты BT.601, как у COLOR_BGR2GRAY, с точностью 1/256; отличие от
+ * cvtColor - не больше 1). AVX2-ядро обрабатывает по 16 пикселей: три
+ * загрузки по 16 байт разбираются на каналы через pshufb, яркость
+ * считается в 16-битных словах и тем же pshufb раскладывается обратно во
+ * все три канала. Фильтры 3x3 и порог тоже имеют AVX2-версии для
+ * внутренних пикселей строки, края считаются скалярно.
+ *
+ * EffectChain - цепочка фильтров над яркостью (размытие 3x3, контуры
+ * Собеля, порог), выполняемая за один проход по кадру: строки идут сверху
+ * вниз, каждый фильтр 3x3 держит кольцо из трёх строк своего входа и
+ * отстаёт на одну строку, результат пишется обратно в уже пройденные
+ * строки кадра. Пустая цепочка - просто перевод в оттенки серого.
+ */
+
+namespace effects {
+
+const int LUMA_B = 29;
+const int LUMA_G = 150;
+const int LUMA_R = 77;
+
+inline unsigned char lumaOf(const unsigned char* bgr) {
+    return static_cast<unsigned char>((LUMA_B * bgr[0] + LUMA_G * bgr[1] + LUMA_R * bgr[2] + 128) >> 8);
+}
+
+inline bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+/* Маски pshufb: split[c][v] собирает канал c из v-й загрузки, merge[v] раскладывает яркость. */
+struct ShuffleMasks {
+    alignas(16) unsigned char split[3][3][16];
+    alignas(16) unsigned char merge[3][16];
+
+    ShuffleMasks() {
+        for (int v = 0; v < 3; ++v) {
+            for (int i = 0; i < 16; ++i) {
+                for (int c = 0; c < 3; ++c) {
+                    int byte = 3 * i + c - 16 * v;
+                    split[c][v][i] = byte >= 0 && byte < 16 ? static_cast<unsigned char>(byte) : 0x80;
+                }
+                merge[v][i] = static_cast<unsigned char>((16 * v + i) / 3);
+            }
+        }
+    }
+};
+
+inline const ShuffleMasks& shuffleMasks() {
+    static const ShuffleMasks masks;
+    return masks;
+}
+
+__attribute__((target("avx2"), always_inline))
+inline __m128i channel16(const __m128i v[3], const ShuffleMasks& m, int c) {
+    __m128i r = _mm_shuffle_epi8(v[0], _mm_load_si128(reinterpret_cast<const __m128i*>(m.split[c][0])));
+    r = _mm_or_si128(r, _mm_shuffle_epi8(v[1], _mm_load_si128(reinterpret_cast<const __m128i*>(m.split[c][1]))));
+    return _mm_or_si128(r, _mm_shuffle_epi8(v[2], _mm_load_si128(reinterpret_cast<const __m128i*>(m.split[c][2]))));
+}
+
+/* Яркость 16 пикселей BGR, начиная с bgr. */
+__attribute__((target("avx2"), always_inline))
+inline __m128i luma16(const unsigned char* bgr, const ShuffleMasks& m) {
+    __m128i v[3];
+    for (int k = 0; k < 3; ++k) {
+        v[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 16 * k));
+    }
+    __m256i b = _mm256_cvtepu8_epi16(channel16(v, m, 0));
+    __m256i g = _mm256_cvtepu8_epi16(channel16(v, m, 1));
+    __m256i r = _mm256_cvtepu8_epi16(channel16(v, m, 2));
+    __m256i y = _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(LUMA_B)),
+                                 _mm256_mullo_epi16(g, _mm256_set1_epi16(LUMA_G)));
+    y = _mm256_add_epi16(y, _mm256_mullo_epi16(r, _mm256_set1_epi16(LUMA_R)));
+    y = _mm256_srli_epi16(_mm256_add_epi16(y, _mm256_set1_epi16(128)), 8);
+    return _mm_packus_epi16(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+}
+
+__attribute__((target("avx2"), always_inline))
+inline void storeGray16(__m128i y, unsigned char* bgr, const ShuffleMasks& m) {
+    for (int k = 0; k < 3; ++k) {
+        __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(m.merge[k]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bgr + 16 * k), _mm_shuffle_epi8(y, mask));
+    }
+}
+
+__attribute__((target("avx2")))
+inline int grayscaleRowAvx2(unsigned char* bgr, int width) {
+    const ShuffleMasks& m = shuffleMasks();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        storeGray16(luma16(bgr + 3 * x, m), bgr + 3 * x, m);
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+inline int lumaRowAvx2(const unsigned char* bgr, unsigned char* y, int width) {
+    const ShuffleMasks& m = shuffleMasks();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y + x), luma16(bgr + 3 * x, m));
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+inline int storeGrayRowAvx2(const unsigned char* y, unsigned char* bgr, int width) {
+    const ShuffleMasks& m = shuffleMasks();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        storeGray16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x)), bgr + 3 * x, m);
+    }
+    return x;
+}
+
+/* Строка BGR -> серый на месте, за один проход. */
+inline void grayscaleRow(unsigned char* bgr, int width) {
+    int x = hasAvx2() ? grayscaleRowAvx2(bgr, width) : 0;
+    for (; x < width; ++x) {
+        bgr[3 * x] = bgr[3 * x + 1] = bgr[3 * x + 2] = lumaOf(&bgr[3 * x]);
+    }
+}
+
+inline void lumaRow(const unsigned char* bgr, unsigned char* y, int width) {
+    int x = hasAvx2() ? lumaRowAvx2(bgr, y, width) : 0;
+    for (; x < width; ++x) {
+        y[x] = lumaOf(&bgr[3 * x]);
+    }
+}
+
+inline void storeGrayRow(const unsigned char* y, unsigned char* bgr, int width) {
+    int x = hasAvx2() ? storeGrayRowAvx2(y, bgr, width) : 0;
+    for (; x < width; ++x) {
+        bgr[3 * x] = bgr[3 * x + 1] = bgr[3 * x + 2] = y[x];
+    }
+}
+
+__attribute__((target("avx2"), always_inline))
+inline __m256i load16(const unsigned char* p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+/* Сумма столбца с весами 1-2-1 для 16 соседних x. */
+__attribute__((target("avx2"), always_inline))
+inline __m256i column121(const unsigned char* up, const unsigned char* mid, const unsigned char* down, int x) {
+    return _mm256_add_epi16(_mm256_add_epi16(load16(up + x), load16(down + x)), _mm256_slli_epi16(load16(mid + x), 1));
+}
+
+__attribute__((target("avx2"), always_inline))
+inline __m256i row121(const unsigned char* row, int x) {
+    return _mm256_add_epi16(_mm256_add_epi16(load16(row + x - 1), load16(row + x + 1)), _mm256_slli_epi16(load16(row + x), 1));
+}
+
+__attribute__((target("avx2"), always_inline))
+inline void store16(unsigned char* p, __m256i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p),
+                     _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+/* Внутренние пиксели строки (x от 1); возвращает первый необработанный x. */
+__attribute__((target("avx2")))
+inline int blurRowAvx2(const unsigned char* up, const unsigned char* mid, const unsigned char* down,
+                       unsigned char* out, int width) {
+    int x = 1;
+    for (; x + 17 <= width; x += 16) {
+        __m256i sum = _mm256_add_epi16(_mm256_add_epi16(column121(up, mid, down, x - 1), column121(up, mid, down, x + 1)),
+                                       _mm256_slli_epi16(column121(up, mid, down, x), 1));
+        store16(out + x, _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(8)), 4));
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+inline int edgeRowAvx2(const unsigned char* up, const unsigned char* mid, const unsigned char* down,
+                       unsigned char* out, int width) {
+    int x = 1;
+    for (; x + 17 <= width; x += 16) {
+        __m256i gx = _mm256_sub_epi16(column121(up, mid, down, x + 1), column121(up, mid, down, x - 1));
+        __m256i gy = _mm256_sub_epi16(row121(down, x), row121(up, x));
+        store16(out + x, _mm256_add_epi16(_mm256_abs_epi16(gx), _mm256_abs_epi16(gy)));
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+inline int thresholdRowAvx2(unsigned char* y, int width, int level) {
+    const __m256i above = _mm256_set1_epi8(static_cast<char>(level + 1));
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + x));
+        __m256i mask = _mm256_cmpeq_epi8(_mm256_max_epu8(v, above), v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(y + x), mask);
+    }
+    return x;
+}
+
+/* Гауссово размытие 3x3 с весами 1-2-1, края повторяются. */
+inline int blurAt(const unsigned char* up, const unsigned char* mid, const unsigned char* down, int l, int x, int r) {
+    int sum = up[l] + 2 * up[x] + up[r] + 2 * (mid[l] + 2 * mid[x] + mid[r]) + down[l] + 2 * down[x] + down[r];
+    return (sum + 8) >> 4;
+}
+
+inline void blurRow(const unsigned char* up, const unsigned char* mid, const unsigned char* down,
+                    unsigned char* out, int width) {
+    out[0] = static_cast<unsigned char>(blurAt(up, mid, down, 0, 0, std::min(1, width - 1)));
+    int x = hasAvx2() ? blurRowAvx2(up, mid, down, out, width) : 1;
+    for (; x < width - 1; ++x) {
+        out[x] = static_cast<unsigned char>(blurAt(up, mid, down, x - 1, x, x + 1));
+    }
+    if (width > 1) {
+        out[width - 1] = static_cast<unsigned char>(blurAt(up, mid, down, width - 2, width - 1, width - 1));
+    }
+}
+
+/* Модуль градиента Собеля |gx| + |gy|, с насыщением. */
+inline int edgeAt(const unsigned char* up, const unsigned char* mid, const unsigned char* down, int l, int x, int r) {
+    int gx = (up[r] + 2 * mid[r] + down[r]) - (up[l] + 2 * mid[l] + down[l]);
+    int gy = (down[l] + 2 * down[x] + down[r]) - (up[l] + 2 * up[x] + up[r]);
+    return std::min(std::abs(gx) + std::abs(gy), 255);
+}
+
+inline void edgeRow(const unsigned char* up, const unsigned char* mid, const unsigned char* down,
+                    unsigned char* out, int width) {
+    out[0] = static_cast<unsigned char>(edgeAt(up, mid, down, 0, 0, std::min(1, width - 1)));
+    int x = hasAvx2() ? edgeRowAvx2(up, mid, down, out, width) : 1;
+    for (; x < width - 1; ++x) {
+        out[x] = static_cast<unsigned char>(edgeAt(up, mid, down, x - 1, x, x + 1));
+    }
+    if (width > 1) {
+        out[width - 1] = static_cast<unsigned char>(edgeAt(up, mid, down, width - 2, width - 1, width - 1));
+    }
+}
+
+inline void thresholdRow(unsigned char* y, int width, int level) {
+    // Векторный путь сравнивает с level + 1 в байте, вне 0..254 порог вырожден.
+    if (level < 0 || level >= 255) {
+        std::memset(y, level < 0 ? 255 : 0, width);
+        return;
+    }
+    int x = hasAvx2() ? thresholdRowAvx2(y, width, level) : 0;
+    for (; x < width; ++x) {
+        y[x] = y[x] > level ? 255 : 0;
+    }
+}
+
+}
+
+enum EffectKind { EFFECT_BLUR, EFFECT_EDGE, EFFECT_THRESHOLD };
+
+class EffectChain {
+public:
+    EffectChain& blur() {
+        stages.push_back({EFFECT_BLUR, 0});
+        return *this;
+    }
+
+    EffectChain& edge() {
+        stages.push_back({EFFECT_EDGE, 0});
+        return *this;
+    }
+
+    EffectChain& threshold(int level) {
+        stages.push_back({EFFECT_THRESHOLD, level});
+        return *this;
+    }
+
+    void clear() {
+        stages.clear();
+    }
+
+    bool empty() const {
+        return stages.empty();
+    }
+
+    /* Применяет цепочку к кадру CV_8UC3 на месте; результат - серый в трёх каналах. */
+    void apply(cv::Mat& frame) {
+        const int width = frame.cols;
+        const int height = frame.rows;
+        if (stages.empty()) {
+            for (int y = 0; y < height; ++y) {
+                effects::grayscaleRow(frame.ptr<unsigned char>(y), width);
+            }
+            return;
+        }
+        // Уровень k - вход k-го фильтра 3x3 (кольцо из трёх строк), последний - выход цепочки.
+        size_t levels = 1;
+        for (const Stage& s : stages) {
+            levels += s.kind != EFFECT_THRESHOLD;
+        }
+        rows.resize(3 * levels);
+        for (std::vector<unsigned char>& row : rows) {
+            row.resize(width);
+        }
+        const int depth = static_cast<int>(levels) - 1;
+        for (int r = 0; r < height + depth; ++r) {
+            size_t level = 0;
+            int produced = r;
+            if (r < height) {
+                unsigned char* row = ringRow(0, r);
+                effects::lumaRow(frame.ptr<unsigned char>(r), row, width);
+            }
+            for (const Stage& s : stages) {
+                if (s.kind == EFFECT_THRESHOLD) {
+                    if (produced >= 0 && produced < height) {
+                        effects::thresholdRow(ringRow(level, produced), width, s.level);
+                    }
+                    continue;
+                }
+                --produced;
+                ++level;
+                if (produced < 0 || produced >= height) {
+                    continue;
+                }
+                const unsigned char* up = ringRow(level - 1, std::max(produced - 1, 0));
+                const unsigned char* mid = ringRow(level - 1, produced);
+                const unsigned char* down = ringRow(level - 1, std::min(produced + 1, height - 1));
+                unsigned char* out = ringRow(level, produced);
+                if (s.kind == EFFECT_BLUR) {
+                    effects::blurRow(up, mid, down, out, width);
+                } else {
+                    effects::edgeRow(up, mid, down, out, width);
+                }
+            }
+            if (produced >= 0 && produced < height) {
+                effects::storeGrayRow(ringRow(level, produced), frame.ptr<unsigned char>(produced), width);
+            }
+        }
+    }
+
+private:
+    struct Stage {
+        EffectKind kind;
+        int level;
+    };
+
+    unsigned char* ringRow(size_t level, int row) {
+        return rows[3 * level + row % 3].data();
+    }
+
+    std::vector<Stage> stages;
+    std::vector<std::vector<unsigned char>> rows;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef LAB5_FRAME_GOVERNOR_H
+#define LAB5_FRAME_GOVERNOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Регулятор нагрузки обработки, включается только явно (targetFps > 0).
+ * Поток обработки после каждого кадра сообщает время обработки и задержку
+ * от захвата до конца обработки (в неё входит и ожидание в очереди, так что
+ * растущая очередь видна сразу). Оба значения сглаживаются экспоненциальным
+ * средним. Перегрузка - обработка дольше 90% бюджета кадра 1/targetFps или
+ * задержка больше latencyBudgetMs; частота показа не учитывается, потому что
+ * её ограничивает источник, а не обработка. Если перегрузка держится
+ * patience кадров подряд, регулятор переходит на следующую ступень:
+ *
+ *   FULL       - обычная обработка;
+ *   SKIP_STALE - обработка пропускает устаревшие кадры и берёт самый новый;
+ *   REDUCED    - эффект на уменьшенной копии кадра (reducedScale) с обратным
+ *                увеличением;
+ *   ROI        - эффект только в центральной области кадра.
+ *
+ * Обратно на ступень вверх - когда обработка укладывается в половину
+ * бюджета кадра, а задержка - в половину latencyBudgetMs в течение
+ * recoverFrames кадров подряд. Если после подъёма перегрузка возвращается
+ * быстрее, чем за 2 * recoverFrames кадров, ожидание перед следующим
+ * подъёмом с этой ступени удваивается (до 32 раз), чтобы не качаться.
+ * Все методы, кроме mode() и droppedFrames(), вызываются из потока обработки.
+ */
+
+enum GovernorMode { GOVERNOR_FULL, GOVERNOR_SKIP_STALE, GOVERNOR_REDUCED, GOVERNOR_ROI, GOVERNOR_MODES };
+
+inline const char* governorModeName(int mode) {
+    static const char* names[GOVERNOR_MODES] = {"full", "skip-stale", "reduced", "roi"};
+    return names[mode];
+}
+
+struct GovernorOptions {
+    double targetFps = 0;
+    double latencyBudgetMs = 100;
+    double reducedScale = 0.5;
+    int patience = 10;
+    int recoverFrames = 60;
+};
+
+class FrameGovernor {
+public:
+    explicit FrameGovernor(const GovernorOptions& options) : options(options) {
+        for (int& frames : recoverNeeded) {
+            frames = options.recoverFrames;
+        }
+    }
+
+    bool enabled() const {
+        return options.targetFps > 0;
+    }
+
+    GovernorMode mode() const {
+        return static_cast<GovernorMode>(currentMode.load(std::memory_order_relaxed));
+    }
+
+    double reducedScale() const {
+        return options.reducedScale;
+    }
+
+    void countDropped(long frames = 1) {
+        dropped.fetch_add(frames, std::memory_order_relaxed);
+    }
+
+    long droppedFrames() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    double smoothedProcessMs() const {
+        return processing * 1e-6;
+    }
+
+    /* Время обработки кадра и задержка от захвата до конца обработки, нс. */
+    void frameProcessed(int64_t processNs, int64_t latencyNs) {
+        if (!enabled()) {
+            return;
+        }
+        const double alpha = 0.1;
+        processing = processing > 0 ? processing + alpha * (processNs - processing) : processNs;
+        latency = latency > 0 ? latency + alpha * (latencyNs - latency) : latencyNs;
+        ++framesInMode;
+        const double frameBudget = 1e9 / options.targetFps;
+        const double latencyBudget = options.latencyBudgetMs * 1e6;
+        const bool over = processing > 0.9 * frameBudget || latency > latencyBudget;
+        const bool headroom = processing < 0.5 * frameBudget && latency < 0.5 * latencyBudget;
+        overFrames = over ? overFrames + 1 : 0;
+        headroomFrames = headroom ? headroomFrames + 1 : 0;
+        int m = currentMode.load(std::memory_order_relaxed);
+        if (overFrames >= options.patience && m + 1 < GOVERNOR_MODES) {
+            if (lastStepUp && framesInMode < 2 * options.recoverFrames) {
+                recoverNeeded[m + 1] = std::min(recoverNeeded[m + 1] * 2, 32 * options.recoverFrames);
+            }
+            switchMode(m + 1, false);
+        } else if (m > GOVERNOR_FULL && headroomFrames >= recoverNeeded[m]) {
+            switchMode(m - 1, true);
+        }
+    }
+
+private:
+    /* Средние после смены ступени набираются заново, чтобы не судить новую ступень по старым кадрам. */
+    void switchMode(int m, bool up) {
+        currentMode.store(m, std::memory_order_relaxed);
+        processing = 0;
+        latency = 0;
+        overFrames = 0;
+        headroomFrames = 0;
+        framesInMode = 0;
+        lastStepUp = up;
+    }
+
+    GovernorOptions options;
+    std::atomic<int> currentMode{GOVERNOR_FULL};
+    std::atomic<long> dropped{0};
+    double processing = 0;
+    double latency = 0;
+    int overFrames = 0;
+    int headroomFrames = 0;
+    int framesInMode = 0;
+    bool lastStepUp = false;
+    int recoverNeeded[GOVERNOR_MODES];
+};
+
+#endif
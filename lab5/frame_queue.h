@@ -0,0 +1,198 @@
+#ifndef LAB5_FRAME_QUEUE_H
+#define LAB5_FRAME_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/*
+ * Кадр, передаваемый между стадиями конвейера: изображение, номер и момент
+ * захвата (для задержки от захвата до показа).
+ */
+struct Frame {
+    cv::Mat image;
+    long index = 0;
+    std::chrono::steady_clock::time_point captured;
+};
+
+enum QueuePolicy { QUEUE_BLOCK, QUEUE_DROP_OLDEST };
+
+/*
+ * Ограниченная очередь кадров без блокировок для одного производителя и
+ * одного потребителя. Слоты создаются заранее, кадры не копируются: push и
+ * pop обменивают содержимое слота с кадром вызывающего (swap заголовков Mat),
+ * так что одни и те же буферы изображений ходят по кругу между стадиями.
+ *
+ * У каждого слота есть номер последовательности (как в очереди Вьюкова):
+ * seq == pos - слот свободен для записи pos, seq == pos + 1 - в слоте лежит
+ * кадр pos. Хвост сдвигается через CAS, поэтому при QUEUE_DROP_OLDEST
+ * производитель может сам выбросить самый старый кадр, не мешая потребителю.
+ *
+ * Ожидающая сторона сначала SPIN_LIMIT раз уступает процессор, а затем
+ * засыпает на условной переменной. Будить приходится только если кто-то
+ * действительно спит (счётчик waiting), так что в обычном режиме мьютекс
+ * не трогается.
+ */
+class FrameQueue {
+public:
+    FrameQueue(size_t capacity, QueuePolicy policy, cv::Size size, int type)
+        : slots(capacity), policy(policy) {
+        for (size_t i = 0; i < capacity; ++i) {
+            slots[i].seq.store(i, std::memory_order_relaxed);
+            slots[i].frame.image.create(size, type);
+        }
+    }
+
+    /*
+     * Кладёт кадр; взамен frame получает буфер освободившегося слота. При
+     * заполненной очереди QUEUE_BLOCK ждёт потребителя, QUEUE_DROP_OLDEST
+     * выбрасывает самый старый кадр. false - очередь закрыта.
+     */
+    bool push(Frame& frame) {
+        for (int spins = 0; !tryPush(frame); ++spins) {
+            if (closed.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (policy == QUEUE_DROP_OLDEST && dropOldest()) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (spins < SPIN_LIMIT) {
+                std::this_thread::yield();
+            } else {
+                block([this] { return canPush(); });
+            }
+        }
+        wakeWaiters();
+        return true;
+    }
+
+    /* Ждёт кадр; false - очередь закрыта и пуста. */
+    bool pop(Frame& frame) {
+        for (int spins = 0; !tryPop(frame); ++spins) {
+            if (closed.load(std::memory_order_acquire)) {
+                return tryPop(frame);
+            }
+            if (spins < SPIN_LIMIT) {
+                std::this_thread::yield();
+            } else {
+                block([this] { return canPop(); });
+            }
+        }
+        return true;
+    }
+
+    /* Забирает кадр, если он есть, не дожидаясь. */
+    bool tryPop(Frame& frame) {
+        if (!take(&frame)) {
+            return false;
+        }
+        wakeWaiters();
+        return true;
+    }
+
+    void close() {
+        closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(waitMutex);
+        changed.notify_all();
+    }
+
+    long droppedFrames() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<size_t> seq;
+        Frame frame;
+    };
+
+    bool tryPush(Frame& frame) {
+        const size_t pos = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[pos % slots.size()];
+        if (slot.seq.load(std::memory_order_acquire) != pos) {
+            return false;
+        }
+        std::swap(slot.frame, frame);
+        slot.seq.store(pos + 1, std::memory_order_release);
+        head.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /* Занимает самый старый кадр через CAS хвоста; при frame != nullptr забирает его содержимое. */
+    bool take(Frame* frame) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos % slots.size()];
+            const size_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != pos + 1) {
+                if (seq < pos + 1) {
+                    return false;
+                }
+                pos = tail.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                if (frame) {
+                    std::swap(slot.frame, *frame);
+                }
+                slot.seq.store(pos + slots.size(), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    bool dropOldest() {
+        return take(nullptr);
+    }
+
+    bool canPush() const {
+        const size_t pos = head.load(std::memory_order_relaxed);
+        return slots[pos % slots.size()].seq.load(std::memory_order_acquire) == pos;
+    }
+
+    bool canPop() const {
+        const size_t pos = tail.load(std::memory_order_relaxed);
+        return slots[pos % slots.size()].seq.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    /*
+     * Сон до ready() или закрытия. Барьеры в block и wakeWaiters не дают
+     * потерять пробуждение: либо спящий увидит новый кадр при проверке под
+     * мьютексом, либо будящий увидит waiting > 0 и возьмёт мьютекс.
+     */
+    template <class Ready>
+    void block(Ready ready) {
+        std::unique_lock<std::mutex> lock(waitMutex);
+        waiting.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        changed.wait(lock, [&] { return ready() || closed.load(std::memory_order_acquire); });
+        waiting.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wakeWaiters() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(waitMutex);
+            changed.notify_all();
+        }
+    }
+
+    static constexpr int SPIN_LIMIT = 64;
+
+    std::vector<Slot> slots;
+    QueuePolicy policy;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    std::atomic<long> dropped{0};
+    std::atomic<bool> closed{false};
+    std::atomic<int> waiting{0};
+    std::mutex waitMutex;
+    std::condition_variable changed;
+};
+
+#endif
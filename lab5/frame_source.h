@@ -0,0 +1,243 @@
+#ifndef LAB5_FRAME_SOURCE_H
+#define LAB5_FRAME_SOURCE_H
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+/*
+ * Откуда берутся кадры и куда уходят. Конвейер processVideoStream работает
+ * с FrameSource и FrameSink, поэтому тот же код можно запустить без камеры
+ * и без окна: источник - видеофайл, последовательность картинок или
+ * генератор, приёмник - пустой или запись в файл. Без окна конвейер не
+ * ограничен частотой камеры и дисплея и идёт с максимальной скоростью.
+ *
+ * Описание источника: "camera:0", "file:video.mp4",
+ * "images:frames/%04d.png", "synthetic:1280x720".
+ * Описание приёмника: "window", "null", "file:out.avi".
+ */
+
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+    /* Следующий кадр в frame (буфер переиспользуется); false - кадры кончились. */
+    virtual bool read(cv::Mat& frame) = 0;
+};
+
+class CaptureSource : public FrameSource {
+public:
+    explicit CaptureSource(int camera) : cap(camera) {}
+    explicit CaptureSource(const std::string& path) : cap(path) {}
+
+    bool opened() const {
+        return cap.isOpened();
+    }
+
+    bool read(cv::Mat& frame) override {
+        cap >> frame;
+        return !frame.empty();
+    }
+
+private:
+    cv::VideoCapture cap;
+};
+
+/*
+ * Файлы по шаблону printf с номером кадра, начиная с 0 (или 1, если 0 нет).
+ * Шаблон приходит из командной строки, поэтому до использования проверяется
+ * validPattern: ровно одно преобразование %d или %i (с флагами и шириной),
+ * остальные % только как %%.
+ */
+class ImageSequenceSource : public FrameSource {
+public:
+    static bool validPattern(const std::string& pattern) {
+        int conversions = 0;
+        for (size_t i = 0; i < pattern.size(); ++i) {
+            if (pattern[i] != '%') {
+                continue;
+            }
+            if (++i < pattern.size() && pattern[i] == '%') {
+                continue;
+            }
+            while (i < pattern.size() && strchr("-+ #0", pattern[i])) {
+                ++i;
+            }
+            while (i < pattern.size() && isdigit(static_cast<unsigned char>(pattern[i]))) {
+                ++i;
+            }
+            if (i < pattern.size() && pattern[i] == '.') {
+                ++i;
+                while (i < pattern.size() && isdigit(static_cast<unsigned char>(pattern[i]))) {
+                    ++i;
+                }
+            }
+            if (i >= pattern.size() || (pattern[i] != 'd' && pattern[i] != 'i')) {
+                return false;
+            }
+            ++conversions;
+        }
+        return conversions == 1;
+    }
+
+    explicit ImageSequenceSource(const std::string& pattern) : pattern(pattern) {
+        if (cv::imread(path(0)).empty()) {
+            index = 1;
+        }
+    }
+
+    bool read(cv::Mat& frame) override {
+        frame = cv::imread(path(index++));
+        return !frame.empty();
+    }
+
+private:
+    std::string path(int i) const {
+        char name[4096];
+        snprintf(name, sizeof(name), pattern.c_str(), i);
+        return name;
+    }
+
+    std::string pattern;
+    int index = 0;
+};
+
+/*
+ * Генератор: движущийся цветной градиент с полосами, чтобы эффекты
+ * получали не плоскую картинку. Узор рисуется один раз с запасом по ширине,
+ * а кадр - сдвинутое окно узора, собранное memcpy строк в тот же буфер, так
+ * что источник почти ничего не стоит и не ограничивает замер.
+ */
+class SyntheticSource : public FrameSource {
+public:
+    explicit SyntheticSource(cv::Size size) : size(size), pattern(size.height, size.width + PERIOD, CV_8UC3) {
+        for (int y = 0; y < pattern.rows; ++y) {
+            unsigned char* row = pattern.ptr<unsigned char>(y);
+            for (int x = 0; x < pattern.cols; ++x) {
+                row[3 * x] = static_cast<unsigned char>(x);
+                row[3 * x + 1] = static_cast<unsigned char>(2 * y);
+                row[3 * x + 2] = ((x + y) & 32) ? 255 : 0;
+            }
+        }
+    }
+
+    bool read(cv::Mat& frame) override {
+        frame.create(size, CV_8UC3);
+        const int shift = tick % PERIOD;
+        for (int y = 0; y < size.height; ++y) {
+            const unsigned char* row = pattern.ptr<unsigned char>((y + tick) % size.height);
+            memcpy(frame.ptr<unsigned char>(y), row + 3 * shift, 3 * size.width);
+        }
+        ++tick;
+        return true;
+    }
+
+private:
+    static const int PERIOD = 256;
+
+    cv::Size size;
+    cv::Mat pattern;
+    int tick = 0;
+};
+
+class FrameSink {
+public:
+    virtual ~FrameSink() {}
+    /* Выводит кадр; возвращает код нажатой клавиши или -1. */
+    virtual int show(const cv::Mat& frame) = 0;
+    /* Нужен ли оверлей с FPS и подсказками. */
+    virtual bool interactive() const {
+        return false;
+    }
+};
+
+class WindowSink : public FrameSink {
+public:
+    ~WindowSink() override {
+        cv::destroyAllWindows();
+    }
+
+    int show(const cv::Mat& frame) override {
+        cv::imshow("Camera Feed", frame);
+        return cv::waitKey(1);
+    }
+
+    bool interactive() const override {
+        return true;
+    }
+};
+
+class NullSink : public FrameSink {
+public:
+    int show(const cv::Mat&) override {
+        return -1;
+    }
+};
+
+/* Кодирует кадры в видеофайл (MJPG); файл открывается по первому кадру. */
+class VideoFileSink : public FrameSink {
+public:
+    explicit VideoFileSink(const std::string& path) : path(path) {}
+
+    int show(const cv::Mat& frame) override {
+        if (!writer.isOpened()) {
+            writer.open(path, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 30, frame.size());
+        }
+        writer << frame;
+        return -1;
+    }
+
+private:
+    std::string path;
+    cv::VideoWriter writer;
+};
+
+inline bool startsWith(const std::string& s, const char* prefix) {
+    return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+/* Источник по описанию; nullptr - описание не разобрано или устройство не открылось. */
+inline std::unique_ptr<FrameSource> makeFrameSource(const std::string& spec) {
+    if (startsWith(spec, "camera:") || startsWith(spec, "file:")) {
+        std::unique_ptr<CaptureSource> source;
+        if (startsWith(spec, "camera:")) {
+            source.reset(new CaptureSource(atoi(spec.c_str() + 7)));
+        } else {
+            source.reset(new CaptureSource(spec.substr(5)));
+        }
+        if (!source->opened()) {
+            return nullptr;
+        }
+        return std::unique_ptr<FrameSource>(source.release());
+    }
+    if (startsWith(spec, "images:")) {
+        if (!ImageSequenceSource::validPattern(spec.substr(7))) {
+            return nullptr;
+        }
+        return std::unique_ptr<FrameSource>(new ImageSequenceSource(spec.substr(7)));
+    }
+    int width = 0, height = 0;
+    if (startsWith(spec, "synthetic:") && sscanf(spec.c_str() + 10, "%dx%d", &width, &height) == 2 &&
+        width > 0 && height > 0) {
+        return std::unique_ptr<FrameSource>(new SyntheticSource(cv::Size(width, height)));
+    }
+    return nullptr;
+}
+
+inline std::unique_ptr<FrameSink> makeFrameSink(const std::string& spec) {
+    if (spec == "window") {
+        return std::unique_ptr<FrameSink>(new WindowSink());
+    }
+    if (spec == "null") {
+        return std::unique_ptr<FrameSink>(new NullSink());
+    }
+    if (startsWith(spec, "file:")) {
+        return std::unique_ptr<FrameSink>(new VideoFileSink(spec.substr(5)));
+    }
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef LAB5_FRAME_TRACE_H
+#define LAB5_FRAME_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * Трассировка конвейера по настенным часам: для каждого кадра и стадии
+ * записываются моменты начала и конца (steady_clock, нс от старта). У
+ * каждой стадии своё заранее выделенное кольцо событий, в которое пишет
+ * только поток этой стадии, поэтому запись - два чтения часов и пара
+ * присваиваний, без атомиков и выделений. Кольцо хранит последние
+ * capacity событий для выгрузки в формате Chrome trace (chrome://tracing,
+ * Perfetto), а длительности всех кадров копятся в логарифмической
+ * гистограмме (16 делений на каждую степень двойки, погрешность < 7%),
+ * по которой в конце считаются p50/p95/p99/max.
+ */
+
+enum TraceStage { TRACE_CAPTURE, TRACE_PROCESS, TRACE_DISPLAY, TRACE_LATENCY, TRACE_STAGES };
+
+inline const char* traceStageName(int stage) {
+    static const char* names[TRACE_STAGES] = {"capture", "process", "display", "capture-to-display"};
+    return names[stage];
+}
+
+class LatencyHistogram {
+public:
+    void add(int64_t ns) {
+        uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        ++buckets[bucketOf(v)];
+        ++count;
+        sum += v;
+        max = v > max ? v : max;
+    }
+
+    /* Нижняя граница деления, в которое попадает доля q всех значений. */
+    uint64_t percentile(double q) const {
+        uint64_t target = static_cast<uint64_t>(q * count);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            seen += buckets[b];
+            if (seen > target) {
+                return lowerBound(b);
+            }
+        }
+        return max;
+    }
+
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+private:
+    static const size_t SUB = 16;
+    static const size_t BUCKETS = 61 * SUB;
+
+    static size_t bucketOf(uint64_t v) {
+        if (v < SUB) {
+            return v;
+        }
+        int e = 63 - __builtin_clzll(v);
+        return (e - 3) * SUB + ((v >> (e - 4)) & (SUB - 1));
+    }
+
+    static uint64_t lowerBound(size_t b) {
+        if (b < SUB) {
+            return b;
+        }
+        int e = static_cast<int>(b / SUB) + 3;
+        return (SUB + b % SUB) << (e - 4);
+    }
+
+    uint64_t buckets[BUCKETS] = {};
+};
+
+class FrameTrace {
+public:
+    explicit FrameTrace(size_t capacity = 1 << 14) : origin(std::chrono::steady_clock::now()) {
+        for (Ring& ring : rings) {
+            ring.events.resize(capacity);
+        }
+    }
+
+    int64_t now() const {
+        return toNs(std::chrono::steady_clock::now());
+    }
+
+    int64_t toNs(std::chrono::steady_clock::time_point t) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t - origin).count();
+    }
+
+    /* Вызывается только из потока, владеющего стадией stage. */
+    void record(TraceStage stage, long frame, int64_t begin, int64_t end) {
+        Ring& ring = rings[stage];
+        Event& e = ring.events[ring.written++ % ring.events.size()];
+        e.frame = frame;
+        e.begin = begin;
+        e.end = end;
+        ring.histogram.add(end - begin);
+    }
+
+    const LatencyHistogram& histogram(TraceStage stage) const {
+        return rings[stage].histogram;
+    }
+
+    double seconds(TraceStage stage) const {
+        return rings[stage].histogram.sum * 1e-9;
+    }
+
+    void printHistograms(std::ostream& out) const {
+        out << "Stage\tframes\tp50 ms\tp95 ms\tp99 ms\tmax ms" << std::endl;
+        for (int s = 0; s < TRACE_STAGES; ++s) {
+            const LatencyHistogram& h = rings[s].histogram;
+            out << traceStageName(s) << "\t" << h.count << "\t" << h.percentile(0.50) * 1e-6 << "\t"
+                << h.percentile(0.95) * 1e-6 << "\t" << h.percentile(0.99) * 1e-6 << "\t" << h.max * 1e-6
+                << std::endl;
+        }
+    }
+
+    /* Последние события каждой стадии в формате Chrome trace-event (JSON). */
+    bool writeChromeTrace(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) {
+            return false;
+        }
+        out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+        bool first = true;
+        for (int s = 0; s < TRACE_STAGES; ++s) {
+            const Ring& ring = rings[s];
+            size_t kept = ring.written < ring.events.size() ? ring.written : ring.events.size();
+            for (size_t i = ring.written - kept; i < ring.written; ++i) {
+                const Event& e = ring.events[i % ring.events.size()];
+                out << (first ? "" : ",") << "\n{\"name\":\"" << traceStageName(s) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                    << s << ",\"ts\":" << e.begin / 1000.0 << ",\"dur\":" << (e.end - e.begin) / 1000.0
+                    << ",\"args\":{\"frame\":" << e.frame << "}}";
+                first = false;
+            }
+        }
+        out << "\n]}" << std::endl;
+        return static_cast<bool>(out);
+    }
+
+    /* Стоимость одной записи (два чтения часов + record) в нс, замер на отдельной трассе. */
+    static double measureOverhead(size_t iterations = 1 << 20) {
+        FrameTrace scratch(1 << 10);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            int64_t begin = scratch.now();
+            scratch.record(TRACE_PROCESS, static_cast<long>(i), begin, scratch.now());
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+               iterations;
+    }
+
+private:
+    struct Event {
+        long frame;
+        int64_t begin;
+        int64_t end;
+    };
+
+    struct alignas(64) Ring {
+        std::vector<Event> events;
+        size_t written = 0;
+        LatencyHistogram histogram;
+    };
+
+    std::chrono::steady_clock::time_point origin;
+    Ring rings[TRACE_STAGES];
+};
+
+#endif
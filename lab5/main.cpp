@@ -1,78 +1,235 @@
-#include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <iostream>
-#include <opencv2/opencv.hpp> 
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "effects.h"
+#include "frame_queue.h"
+#include "frame_governor.h"
+#include "frame_source.h"
+#include "frame_trace.h"
 
 using namespace cv;
 using namespace std;
 
-bool grayscaleEnabled = false;
+atomic<bool> grayscaleEnabled(false);
 
-void applyGrayscaleEffect(Mat& frame) {
-    if (grayscaleEnabled) {
-        cvtColor(frame, frame, COLOR_BGR2GRAY);
-        cvtColor(frame, frame, COLOR_GRAY2BGR);
+enum { EFFECT_MASK_BLUR = 1, EFFECT_MASK_EDGE = 2, EFFECT_MASK_THRESHOLD = 4 };
+atomic<unsigned> effectMask(0);
+
+/* Прежний путь через два cvtColor, оставлен для сравнения в --effect-bench. */
+void applyGrayscaleCvtColor(Mat& frame) {
+    cvtColor(frame, frame, COLOR_BGR2GRAY);
+    cvtColor(frame, frame, COLOR_GRAY2BGR);
+}
+
+/* Цепочка перестраивается только при смене набора эффектов. */
+void configureEffects(EffectChain& chain, unsigned mask) {
+    chain.clear();
+    if (mask & EFFECT_MASK_BLUR) {
+        chain.blur();
+    }
+    if (mask & EFFECT_MASK_EDGE) {
+        chain.edge();
+    }
+    if (mask & EFFECT_MASK_THRESHOLD) {
+        chain.threshold(96);
     }
 }
 
-void updateAndDisplayFPS(Mat& frame, long& frameCounter, clock_t& lastFpsTime, string& fpsText) {
-    clock_t currentTime = clock();
-    double dif = double(currentTime - lastFpsTime) / CLOCKS_PER_SEC;
+/*
+ * Эффект с учётом ступени регулятора: REDUCED обрабатывает уменьшенную
+ * копию в reduced (буфер переиспользуется) и растягивает результат обратно,
+ * ROI обрабатывает только центральную четверть кадра.
+ */
+void applyGrayscaleEffect(Mat& frame, EffectChain& chain, unsigned& configuredMask, GovernorMode mode,
+    double scale, Mat& reduced) {
+    unsigned mask = effectMask;
+    if (mask != configuredMask) {
+        configureEffects(chain, mask);
+        configuredMask = mask;
+    }
+    if (!grayscaleEnabled && mask == 0) {
+        return;
+    }
+    if (mode == GOVERNOR_REDUCED) {
+        Size small(max(1, int(frame.cols * scale)), max(1, int(frame.rows * scale)));
+        resize(frame, reduced, small, 0, 0, INTER_AREA);
+        chain.apply(reduced);
+        resize(reduced, frame, frame.size(), 0, 0, INTER_LINEAR);
+    } else if (mode == GOVERNOR_ROI) {
+        Mat roi = frame(Rect(frame.cols / 4, frame.rows / 4, frame.cols / 2, frame.rows / 2));
+        chain.apply(roi);
+    } else {
+        chain.apply(frame);
+    }
+}
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void updateAndDisplayFPS(Mat& frame, long& frameCounter, chrono::steady_clock::time_point& lastFpsTime,
+    string& fpsText, const string& governorText) {
+    double dif = secondsSince(lastFpsTime);
     if (dif >= 1.0) {
         fpsText = "FPS: " + to_string(frameCounter);
         frameCounter = 0;
-        lastFpsTime = currentTime;
+        lastFpsTime = chrono::steady_clock::now();
     }
     putText(frame, fpsText, Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.7, Scalar(255, 255, 255), 2);
-    putText(frame, "SPACE: Grayscale | ESC: Exit", Point(10, 60), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(255, 255, 255), 1);
+    putText(frame, "SPACE: Grayscale | B/E/T: Blur/Edge/Threshold | ESC: Exit", Point(10, 60), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(255, 255, 255), 1);
+    putText(frame, governorText, Point(10, 85), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(255, 255, 255), 1);
 }
 
-void printStatistics(clock_t totalTime, clock_t inputTime, clock_t procTime,
-    clock_t outputTime, long frameCounter) {
-    if (totalTime > 0 && frameCounter > 0) {
-        double totalSeconds = double(totalTime) / CLOCKS_PER_SEC;
+/*
+ * Время стадий - сумма занятости каждого потока по трассе (без ожидания
+ * очередей, но с блокировкой внутри стадии, например в waitKey), в
+ * процентах от общего времени; стадии работают параллельно, поэтому
+ * проценты в сумме могут превышать 100.
+ */
+struct PipelineStats {
+    long captured = 0;
+    long processed = 0;
+    long displayed = 0;
+    long droppedCapture = 0;
+    long droppedDisplay = 0;
+    long droppedStale = 0;
+    bool governed = false;
+    GovernorMode finalMode = GOVERNOR_FULL;
+};
+
+void printStatistics(double totalTime, const PipelineStats& stats, const FrameTrace& trace) {
+    if (totalTime > 0 && stats.displayed > 0) {
         double percentage = totalTime / 100.0;
+        double inputTime = trace.seconds(TRACE_CAPTURE);
+        double procTime = trace.seconds(TRACE_PROCESS);
+        double outputTime = trace.seconds(TRACE_DISPLAY);
         cout << "\n~~~~ Statistics ~~~~" << endl;
-        cout << "Total time: " << totalSeconds << " seconds" << endl;
-        cout << "Input time: " << (inputTime / percentage) << "%" << endl;  
-        cout << "Process time: " << (procTime / percentage) << "%" << endl;      
-        cout << "Output time: " << (outputTime / percentage) << "%" << endl; 
-        cout << "Other time: " << ((totalTime - inputTime - procTime - outputTime) / percentage) << "%" << endl;
+        cout << "Total time: " << totalTime << " seconds" << endl;
+        cout << "Input time: " << (inputTime / percentage) << "% ("
+             << 1000 * inputTime / max(stats.captured, 1L) << " ms/frame)" << endl;
+        cout << "Process time: " << (procTime / percentage) << "% ("
+             << 1000 * procTime / max(stats.processed, 1L) << " ms/frame)" << endl;
+        cout << "Output time: " << (outputTime / percentage) << "% ("
+             << 1000 * outputTime / stats.displayed << " ms/frame)" << endl;
+        cout << "Throughput: " << stats.displayed / totalTime << " frames/s (" << stats.displayed << " frames)" << endl;
+        cout << "Dropped frames: " << stats.droppedCapture << " before processing, " << stats.droppedDisplay
+             << " before display, " << stats.droppedStale << " stale skipped by governor" << endl;
+        if (stats.governed) {
+            cout << "Governor mode at exit: " << governorModeName(stats.finalMode) << endl;
+        }
+        cout << endl;
+        trace.printHistograms(cout);
+        // Четыре записи на кадр (три стадии и задержка); оценка сверху, часть чтений часов у записей общая.
+        double overhead = FrameTrace::measureOverhead();
+        cout << "Tracing overhead: " << overhead << " ns/event, " << overhead * TRACE_STAGES * 1e-3
+             << " us/frame" << endl;
     }
 }
 
-void processVideoStream() {
-    clock_t startTime = clock(); 
-    VideoCapture cap(0);
-    if (!cap.isOpened()) {
-        cerr << "Error: Could not open camera" << endl;
+struct StreamOptions {
+    size_t queueSize = 4;
+    QueuePolicy policy = QUEUE_BLOCK;
+    long maxFrames = 0;
+    string tracePath;
+    GovernorOptions governor;
+};
+
+/*
+ * Захват, обработка и показ в трёх потоках, связанных очередями FrameQueue
+ * по queueSize кадров. Показ остаётся в главном потоке (HighGUI требует
+ * этого на части платформ), остальные стадии - в своих потоках. При
+ * maxFrames > 0 поток останавливается после этого числа кадров, что вместе
+ * с приёмником без окна даёт воспроизводимый замер.
+ */
+void processVideoStream(FrameSource& source, FrameSink& sink, const StreamOptions& options) {
+    auto startTime = chrono::steady_clock::now();
+    Frame first;
+    if (!source.read(first.image)) {
+        cerr << "Error: Could not read the first frame" << endl;
         return;
     }
-    long frameCounter = 0;      
-    Mat frame;                    
-    clock_t inputTime = 0;        
-    clock_t procTime = 0;         
-    clock_t outputTime = 0;       
-    clock_t lastFpsTime = startTime; 
-    string fpsText = "FPS: 0";   
-
-    while (true) {
-        clock_t inputStart = clock(); 
-        cap >> frame;
-        if (frame.empty()) {
-            break;
+    const Size frameSize = first.image.size();
+    const int frameType = first.image.type();
+    FrameQueue captured(options.queueSize, options.policy, frameSize, frameType);
+    FrameQueue processed(options.queueSize, options.policy, frameSize, frameType);
+    PipelineStats stats;
+    FrameTrace trace;
+    FrameGovernor governor(options.governor);
+    atomic<bool> running(true);
+
+    thread captureThread([&] {
+        Frame frame;
+        swap(frame.image, first.image);
+        frame.captured = chrono::steady_clock::now();
+        stats.captured = 1;
+        for (long index = 1; running; ++index) {
+            if (!captured.push(frame)) {
+                break;
+            }
+            if (options.maxFrames > 0 && index >= options.maxFrames) {
+                break;
+            }
+            int64_t inputStart = trace.now();
+            if (!source.read(frame.image)) {
+                break;
+            }
+            frame.index = index;
+            frame.captured = chrono::steady_clock::now();
+            trace.record(TRACE_CAPTURE, index, inputStart, trace.toNs(frame.captured));
+            stats.captured++;
+        }
+        captured.close();
+    });
+    thread processThread([&] {
+        Frame frame;
+        frame.image.create(frameSize, frameType);
+        EffectChain chain;
+        unsigned configuredMask = 0;
+        Mat reduced;
+        while (captured.pop(frame)) {
+            GovernorMode mode = governor.mode();
+            if (governor.enabled() && mode >= GOVERNOR_SKIP_STALE) {
+                // Берётся самый свежий кадр, более старые возвращаются в очередь захвата.
+                while (captured.tryPop(frame)) {
+                    governor.countDropped();
+                }
+            }
+            int64_t procStart = trace.now();
+            applyGrayscaleEffect(frame.image, chain, configuredMask, mode, governor.reducedScale(), reduced);
+            int64_t procEnd = trace.now();
+            trace.record(TRACE_PROCESS, frame.index, procStart, procEnd);
+            governor.frameProcessed(procEnd - procStart, procEnd - trace.toNs(frame.captured));
+            stats.processed++;
+            if (!processed.push(frame)) {
+                break;
+            }
         }
-        inputTime += (clock() - inputStart);
-
-        clock_t procStart = clock();
-        applyGrayscaleEffect(frame);
-        procTime += (clock() - procStart);
-        updateAndDisplayFPS(frame, frameCounter, lastFpsTime, fpsText);
-        clock_t outputStart = clock();
-        imshow("Camera Feed", frame);
+        processed.close();
+    });
+
+    long frameCounter = 0;
+    auto lastFpsTime = startTime;
+    string fpsText = "FPS: 0";
+    Frame frame;
+    frame.image.create(frameSize, frameType);
+    while (processed.pop(frame)) {
+        if (sink.interactive()) {
+            long drops = governor.droppedFrames() + captured.droppedFrames() + processed.droppedFrames();
+            string governorText = string("Mode: ") + governorModeName(governor.mode()) + " | Dropped: " + to_string(drops);
+            updateAndDisplayFPS(frame.image, frameCounter, lastFpsTime, fpsText, governorText);
+        }
+        int64_t outputStart = trace.now();
+        char key = (char)sink.show(frame.image);
         frameCounter++;
-        outputTime += (clock() - outputStart);
+        int64_t outputEnd = trace.now();
+        trace.record(TRACE_DISPLAY, frame.index, outputStart, outputEnd);
+        trace.record(TRACE_LATENCY, frame.index, trace.toNs(frame.captured), outputEnd);
+        stats.displayed++;
 
-        char key = (char)waitKey(1);
         if (key == 27) {
             break;
         }
@@ -80,14 +237,120 @@ void processVideoStream() {
             grayscaleEnabled = !grayscaleEnabled;
             cout << "Grayscale " << (grayscaleEnabled ? "ENABLED" : "DISABLED") << endl;
         }
+        else if (key == 'b' || key == 'e' || key == 't') {
+            unsigned bit = key == 'b' ? EFFECT_MASK_BLUR : key == 'e' ? EFFECT_MASK_EDGE : EFFECT_MASK_THRESHOLD;
+            effectMask ^= bit;
+            cout << "Effects mask " << effectMask << endl;
+        }
+    }
+    running = false;
+    captured.close();
+    processed.close();
+    captureThread.join();
+    processThread.join();
+    stats.droppedCapture = captured.droppedFrames();
+    stats.droppedDisplay = processed.droppedFrames();
+    stats.droppedStale = governor.droppedFrames();
+    stats.governed = governor.enabled();
+    stats.finalMode = governor.mode();
+    printStatistics(secondsSince(startTime), stats, trace);
+    if (!options.tracePath.empty()) {
+        if (trace.writeChromeTrace(options.tracePath)) {
+            cout << "Trace written to " << options.tracePath << endl;
+        } else {
+            cerr << "Error: Could not write trace " << options.tracePath << endl;
+        }
     }
-    clock_t totalTime = clock() - startTime; 
-    printStatistics(totalTime, inputTime, procTime, outputTime, frameCounter);
-    cap.release();
-    destroyAllWindows();
+}
+
+/*
+ * ns на пиксель: два cvtColor против однопроходного ядра яркости и
+ * слитой цепочки эффектов на синтетических кадрах 720p и 1080p.
+ */
+void effectBenchmark() {
+    const Size sizes[] = {Size(1280, 720), Size(1920, 1080)};
+    const int iterations = 50;
+    cout << "Resolution\tcvtColor x2\tluma kernel\tblur+edge+threshold\tmax diff" << endl;
+    for (Size size : sizes) {
+        Mat source(size, CV_8UC3);
+        randu(source, 0, 256);
+        Mat frame;
+        EffectChain gray;
+        EffectChain fused;
+        fused.blur().edge().threshold(96);
+        auto measure = [&](auto effect) {
+            source.copyTo(frame);
+            effect(frame);
+            double total = 0;
+            for (int i = 0; i < iterations; ++i) {
+                source.copyTo(frame);
+                auto start = chrono::steady_clock::now();
+                effect(frame);
+                total += secondsSince(start);
+            }
+            return total / iterations / size.area() * 1e9;
+        };
+        double cvtTime = measure([](Mat& f) { applyGrayscaleCvtColor(f); });
+        Mat reference = frame.clone();
+        double lumaTime = measure([&](Mat& f) { gray.apply(f); });
+        int diff = 0;
+        for (int y = 0; y < size.height; ++y) {
+            for (int x = 0; x < size.width * 3; ++x) {
+                diff = max(diff, abs(frame.ptr<unsigned char>(y)[x] - reference.ptr<unsigned char>(y)[x]));
+            }
+        }
+        double chainTime = measure([&](Mat& f) { fused.apply(f); });
+        cout << size.width << "x" << size.height << "\t" << cvtTime << "\t" << lumaTime << "\t" << chainTime
+             << "\t" << diff << endl;
+    }
+}
+
+/* Начальный набор эффектов из списка вида "gray,blur,edge,threshold". */
+void enableEffects(const string& list) {
+    grayscaleEnabled = list.find("gray") != string::npos;
+    effectMask = (list.find("blur") != string::npos ? EFFECT_MASK_BLUR : 0) |
+                 (list.find("edge") != string::npos ? EFFECT_MASK_EDGE : 0) |
+                 (list.find("threshold") != string::npos ? EFFECT_MASK_THRESHOLD : 0);
 }
 
 int main(int argc, char* argv[]) {
-    processVideoStream();
+    StreamOptions options;
+    string sourceSpec = "camera:0";
+    string sinkSpec = "window";
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            options.queueSize = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--drop-oldest") == 0) {
+            options.policy = QUEUE_DROP_OLDEST;
+        } else if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+            sourceSpec = argv[++i];
+        } else if (strcmp(argv[i], "--sink") == 0 && i + 1 < argc) {
+            sinkSpec = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.maxFrames = max(atol(argv[++i]), 0L);
+        } else if (strcmp(argv[i], "--target-fps") == 0 && i + 1 < argc) {
+            options.governor.targetFps = max(atof(argv[++i]), 0.0);
+        } else if (strcmp(argv[i], "--latency-budget") == 0 && i + 1 < argc) {
+            options.governor.latencyBudgetMs = max(atof(argv[++i]), 1.0);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--effects") == 0 && i + 1 < argc) {
+            enableEffects(argv[++i]);
+        } else if (strcmp(argv[i], "--effect-bench") == 0) {
+            effectBenchmark();
+            return 0;
+        }
+    }
+    unique_ptr<FrameSource> source = makeFrameSource(sourceSpec);
+    if (!source) {
+        cerr << "Error: Could not open source " << sourceSpec << endl;
+        return 1;
+    }
+    unique_ptr<FrameSink> sink = makeFrameSink(sinkSpec);
+    if (!sink) {
+        cerr << "Error: Unknown sink " << sinkSpec << endl;
+        return 1;
+    }
+    processVideoStream(*source, *sink, options);
     return 0;
 }
@@ -1,6 +1,23 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
 #include <iostream>
 #include <libusb.h>
 #include <iomanip>
+#include <memory>
+#include <string>
+#include "usb_device.h"
+#include "usb_inventory.h"
+#include "usb_libusb_backend.h"
+#include "usb_mock_backend.h"
+
+#ifdef __linux__
+#include <ftw.h>
+#include <sys/stat.h>
+#include "usb_sysfs.h"
+#endif
 
 #ifdef _WIN32
 #include <windows.h>
@@ -32,25 +49,53 @@ string getDeviceClassName(uint8_t deviceClass) {
     }
 }
 
-void print_device(libusb_device* dev) {
-    libusb_device_descriptor desc{};
-    int result = libusb_get_device_descriptor(dev, &desc);
-    if (result < 0) {
-        cerr << "Ошибка получения дескриптора устройства: " << libusb_error_name(result) << endl;
-        return;
-    }
-
+void print_ids(uint8_t deviceClass, uint16_t idVendor, uint16_t idProduct) {
     cout << "---------------------------------------------------" << endl;
     
-    string className = getDeviceClassName(desc.bDeviceClass);
+    string className = getDeviceClassName(deviceClass);
     cout << "Класс устройства:    " << className << " (0x" << hex << setw(2) << setfill('0') 
-         << static_cast<int>(desc.bDeviceClass) << ")" << dec << endl;
+         << static_cast<int>(deviceClass) << ")" << dec << endl;
     
     cout << "Vendor ID:           0x" << hex << setw(4) << setfill('0') 
-         << desc.idVendor << dec << endl;
+         << idVendor << dec << endl;
     
     cout << "Product ID:          0x" << hex << setw(4) << setfill('0') 
-         << desc.idProduct << dec << endl;
+         << idProduct << dec << endl;
+}
+
+void print_device_info(const UsbDeviceInfo& info) {
+    print_ids(info.deviceClass, info.idVendor, info.idProduct);
+    if (info.hasSerial) {
+        cout << "Серийный номер:      " << info.serial << endl;
+    }
+    else {
+        cout << "Серийный номер:     <отсутствует>" << endl;
+    }
+}
+
+/*
+ * Дескриптор устройства libusb берёт без открытия (на Linux - из sysfs),
+ * открывать устройство нужно только ради строки серийного номера. Если
+ * запись sysfs есть, всё берётся из неё, а libusb_open остаётся запасным
+ * путём для серийного номера, которого в sysfs нет.
+ */
+void print_device(libusb_device* dev, const UsbDeviceInfo* info = nullptr) {
+    libusb_device_descriptor desc{};
+    int result = libusb_get_device_descriptor(dev, &desc);
+    if (result < 0) {
+        cerr << "Ошибка получения дескриптора устройства: " << libusb_error_name(result) << endl;
+        return;
+    }
+
+#ifdef __linux__
+    if (info != nullptr && (info->hasSerial || desc.iSerialNumber == 0)) {
+        print_device_info(*info);
+        cout.flush();
+        return;
+    }
+#endif
+
+    print_ids(desc.bDeviceClass, desc.idVendor, desc.idProduct);
 
     libusb_device_handle* handle = nullptr;
     result = libusb_open(dev, &handle);
@@ -79,11 +124,349 @@ void print_device(libusb_device* dev) {
     cout.flush();
 }
 
-int main(void) 
+#ifdef __linux__
+void write_attribute(const string& dir, const char* name, const string& value) {
+    FILE* f = fopen((dir + "/" + name).c_str(), "w");
+    if (f != nullptr) {
+        fprintf(f, "%s\n", value.c_str());
+        fclose(f);
+    }
+}
+
+string hex4(unsigned value) {
+    char text[8];
+    snprintf(text, sizeof(text), "%04x", value & 0xffff);
+    return text;
+}
+
+/* Что должно лежать в поддельном дереве для устройства index с номером devnum. */
+UsbDeviceInfo fake_device_info(int index, int devnum) {
+    UsbDeviceInfo info;
+    info.busnum = 1 + index / 100;
+    info.devnum = devnum;
+    info.name = to_string(info.busnum) + "-" + to_string(1 + index % 100 / 10) + "." + to_string(1 + index % 10);
+    info.idVendor = static_cast<uint16_t>(0x1000 + index);
+    info.idProduct = static_cast<uint16_t>(0x2000 + devnum);
+    info.deviceClass = index % 3 == 0 ? 0x09 : 0x00;
+    info.hasSerial = index % 2 == 0;
+    if (info.hasSerial) {
+        info.serial = "SN" + to_string(100000 + index);
+    }
+    info.manufacturer = "Vendor " + to_string(index);
+    info.product = "Device " + to_string(index);
+    return info;
+}
+
+/* Синтетическое устройство в поддельном дереве sysfs; у каждого второго есть интерфейс. */
+void write_fake_device(const string& root, int index, int devnum) {
+    UsbDeviceInfo info = fake_device_info(index, devnum);
+    string dir = root + "/" + info.name;
+    mkdir(dir.c_str(), 0755);
+    write_attribute(dir, "busnum", to_string(info.busnum));
+    write_attribute(dir, "devnum", to_string(info.devnum));
+    write_attribute(dir, "idVendor", hex4(info.idVendor));
+    write_attribute(dir, "idProduct", hex4(info.idProduct));
+    write_attribute(dir, "bDeviceClass", info.deviceClass == 0x09 ? "09" : "00");
+    write_attribute(dir, "manufacturer", info.manufacturer);
+    write_attribute(dir, "product", info.product);
+    if (info.hasSerial) {
+        write_attribute(dir, "serial", info.serial);
+        mkdir((dir + ":1.0").c_str(), 0755);
+    }
+}
+
+int remove_entry(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+}
+
+template <class F>
+double time_ms(F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void print_scan(const char* label, double ms, const SysfsScanStats& stats) {
+    cout << label << ": " << ms << " мс (" << ms * 1000 / max<size_t>(stats.devices, 1) << " мкс/устройство), устройств "
+         << stats.devices << ", из кэша " << stats.cacheHits << ", прочитано " << stats.fullReads << ", удалено "
+         << stats.removed << endl;
+}
+
+/*
+ * Замер скана поддельного дерева sysfs из count устройств во временном
+ * каталоге: холодный скан, повторный скан с кэшем и скан после того, как
+ * 1% устройств переподключился (новый devnum) и 1% пропал.
+ */
+int sysfs_benchmark(int count) {
+    char root[] = "/tmp/lab6-sysfs-XXXXXX";
+    if (mkdtemp(root) == nullptr) {
+        cerr << "Не удалось создать временный каталог" << endl;
+        return 1;
+    }
+    for (int i = 0; i < count; ++i) {
+        write_fake_device(root, i, 2 + i % 120);
+    }
+
+    SysfsUsbScanner scanner(root);
+    const int repeats = 20;
+    print_scan("Холодный скан", time_ms([&] { scanner.scan(); }), scanner.stats());
+    double warm = time_ms([&] {
+        for (int r = 0; r < repeats; ++r) {
+            scanner.scan();
+        }
+    });
+    print_scan("Повторный скан", warm / repeats, scanner.stats());
+
+    int changed = max(count / 100, 1);
+    for (int i = 0; i < changed; ++i) {
+        write_fake_device(root, i * 97 % count, 200 + i);
+    }
+    for (int i = 0; i < changed; ++i) {
+        string name = fake_device_info(count - 1 - i, 0).name;
+        nftw((string(root) + "/" + name).c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+    print_scan("Скан после изменений", time_ms([&] { scanner.scan(); }), scanner.stats());
+
+    scanner.clearCache();
+    print_scan("Скан без кэша", time_ms([&] { scanner.scan(); }), scanner.stats());
+
+    nftw(root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
+
+/* Число расхождений разобранной записи с ожидаемой; первые из них выводятся. */
+int compare_device(const UsbDeviceInfo* got, const UsbDeviceInfo& want, int& reported) {
+    int errors = 0;
+    auto check = [&](bool ok, const char* field) {
+        if (!ok) {
+            ++errors;
+            if (reported++ < 10) {
+                cerr << want.name << ": не совпадает " << field << endl;
+            }
+        }
+    };
+    check(got != nullptr, "наличие");
+    if (got == nullptr) {
+        return errors;
+    }
+    check(got->busnum == want.busnum && got->devnum == want.devnum, "busnum/devnum");
+    check(got->idVendor == want.idVendor, "idVendor");
+    check(got->idProduct == want.idProduct, "idProduct");
+    check(got->deviceClass == want.deviceClass, "bDeviceClass");
+    check(got->hasSerial == want.hasSerial && got->serial == want.serial, "serial");
+    check(got->manufacturer == want.manufacturer && got->product == want.product, "manufacturer/product");
+    return errors;
+}
+
+/*
+ * Проверка разбора на поддельном дереве из count устройств: каждое поле
+ * скана сравнивается с тем, что было записано, затем lookup() после
+ * переподключения (полное чтение), без изменений (из кэша) и после
+ * отключения. Код возврата 1, если что-то не совпало.
+ */
+int sysfs_selftest(int count) {
+    char root[] = "/tmp/lab6-sysfs-XXXXXX";
+    if (mkdtemp(root) == nullptr) {
+        cerr << "Не удалось создать временный каталог" << endl;
+        return 1;
+    }
+    for (int i = 0; i < count; ++i) {
+        write_fake_device(root, i, 2 + i % 120);
+    }
+
+    SysfsUsbScanner scanner(root);
+    int errors = 0;
+    int reported = 0;
+    size_t found = scanner.scan().size();
+    if (found != static_cast<size_t>(count)) {
+        cerr << "Скан нашёл " << found << " устройств из " << count << endl;
+        ++errors;
+    }
+    for (int i = 0; i < count; ++i) {
+        UsbDeviceInfo want = fake_device_info(i, 2 + i % 120);
+        errors += compare_device(scanner.find(want.name), want, reported);
+    }
+
+    UsbDeviceInfo info;
+    UsbDeviceInfo moved = fake_device_info(0, 250);
+    write_fake_device(root, 0, 250);
+    errors += compare_device(scanner.lookup(moved.name, info) ? &info : nullptr, moved, reported);
+    if (count > 1) {
+        UsbDeviceInfo same = fake_device_info(1, 3);
+        errors += compare_device(scanner.lookup(same.name, info) ? &info : nullptr, same, reported);
+        nftw((string(root) + "/" + same.name).c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+        if (scanner.lookup(same.name, info)) {
+            cerr << same.name << ": найдено после отключения" << endl;
+            ++errors;
+        }
+    }
+    const SysfsScanStats& lookups = scanner.lookupStats();
+    size_t expectHits = count > 1 ? 1 : 0;
+    size_t expectRemoved = count > 1 ? 1 : 0;
+    if (lookups.fullReads != 1 || lookups.cacheHits != expectHits || lookups.removed != expectRemoved) {
+        cerr << "lookup: прочитано " << lookups.fullReads << ", из кэша " << lookups.cacheHits << ", удалено "
+             << lookups.removed << endl;
+        ++errors;
+    }
+
+    nftw(root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    cout << "Проверка sysfs на " << count << " устройствах: " << (errors == 0 ? "OK" : "ошибок " + to_string(errors))
+         << endl;
+    return errors == 0 ? 0 : 1;
+}
+
+/* Список прямо из дерева sysfs (настоящего или поддельного), без libusb. */
+int print_sysfs_tree(const string& root) {
+    SysfsUsbScanner scanner(root);
+    if (!scanner.available()) {
+        cerr << "Каталог sysfs недоступен: " << root << endl;
+        return 1;
+    }
+    const vector<const UsbDeviceInfo*>& devices = scanner.scan();
+    cout << "Найдено USB устройств: " << devices.size() << "\n" << endl;
+    for (const UsbDeviceInfo* info : devices) {
+        print_device_info(*info);
+    }
+    cout.flush();
+    return 0;
+}
+#endif
+
+atomic<bool> monitorRunning(true);
+
+void stop_monitor(int) {
+    monitorRunning = false;
+}
+
+void print_scan_report(const ScanReport& report) {
+    cout << "Начальный скан: " << report.devices << " устройств за " << report.seconds * 1000 << " мс, прочитано "
+         << report.read << ", ошибок " << report.failed << ", не ответили за отведённое время " << report.timedOut
+         << endl;
+}
+
+#ifdef __linux__
+void print_sysfs_lookups(const SysfsScanStats& stats) {
+    cout << "sysfs: обращений " << stats.devices << ", из кэша " << stats.cacheHits << ", прочитано "
+         << stats.fullReads << ", удалено " << stats.removed << endl;
+}
+#endif
+
+/* Долгоживущий режим: параллельный скан, затем изменения по hotplug до Ctrl+C. Контекст закрывает источник. */
+int monitor_devices(libusb_context* ctx, int workers, int timeoutMs) {
+    auto backend = make_shared<LibusbBackend>(ctx);
+    InventoryService service(backend, workers, timeoutMs);
+    print_scan_report(service.start());
+#ifdef __linux__
+    print_sysfs_lookups(backend->sysfsStats());
+#endif
+    for (const UsbDeviceInfo& info : service.inventory().snapshot()) {
+        print_device_info(info);
+    }
+    if (!service.subscribed()) {
+        cerr << "Hotplug не поддерживается на этой платформе" << endl;
+        return 1;
+    }
+
+    cout << "\nОжидание подключений и отключений (Ctrl+C - выход)" << endl;
+    signal(SIGINT, stop_monitor);
+    service.run(monitorRunning, [&](const UsbEvent& event) {
+        if (event.type == USB_ARRIVED) {
+            cout << "\nПодключено: " << event.info.name << endl;
+            print_device_info(event.info);
+        }
+        else {
+            cout << "\nОтключено: " << event.info.name << endl;
+        }
+        cout << "Устройств в инвентаре: " << service.inventory().size() << endl;
+    });
+#ifdef __linux__
+    print_sysfs_lookups(backend->sysfsStats());
+#endif
+    return 0;
+}
+
+/*
+ * Замер на имитации: devices устройств по 200 мкс на чтение, каждое 50-е
+ * при первом чтении зависает на 2 с. Скан пулом из workers потоков с
+ * тайм-аутом, затем events событий с частотой rate (0 - без пауз):
+ * пропускная способность, задержка от выдачи события до обновления
+ * инвентаря и сколько зависших ответило при повторном чтении.
+ */
+int inventory_benchmark(int devices, int events, double rate, int workers, int timeoutMs) {
+    const int readDelayUs = 200;
+    const int hungEvery = 50;
+    const int hangMs = 2000;
+    auto backend = make_shared<MockUsbBackend>(devices, readDelayUs, hungEvery, hangMs);
+    backend->prepareReplay(events, rate);
+    InventoryService service(backend, workers, timeoutMs);
+    print_scan_report(service.start());
+    cout << "Последовательный скан без тайм-аута: ~"
+         << devices * readDelayUs / 1000.0 + devices / hungEvery * hangMs << " мс" << endl;
+
+    atomic<bool> running(true);
+    auto start = chrono::steady_clock::now();
+    backend->startReplay();
+    service.run(running);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    const EventStats& stats = service.stats();
+    vector<int64_t> latency = stats.latencyNs;
+    sort(latency.begin(), latency.end());
+    auto percentile = [&](double q) {
+        return latency.empty() ? 0.0 : latency[min(latency.size() - 1, static_cast<size_t>(q * latency.size()))] / 1000.0;
+    };
+    cout << "События: " << stats.events << " (подключений " << stats.arrivals << ", отключений " << stats.departures
+         << ") за " << seconds * 1000 << " мс, " << stats.events / seconds << " событий/с" << endl;
+    cout << "Задержка обновления, мкс: p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", max "
+         << percentile(1.0) << endl;
+    cout << "Повторное чтение зависших: " << stats.retries << ", ответило " << stats.recovered << ", не ответило "
+         << service.hungDevices() << endl;
+    cout << "Устройств в инвентаре: " << service.inventory().size() << ", изменений: "
+         << service.inventory().version() << endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
     #ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
     #endif
 
+    bool useSysfs = true;
+    bool monitor = false;
+    int workers = 8;
+    int timeoutMs = 500;
+    int benchDevices = 0;
+    int benchEvents = 0;
+    double rate = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--libusb") == 0) {
+            useSysfs = false;
+        } else if (strcmp(argv[i], "--monitor") == 0) {
+            monitor = true;
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            timeoutMs = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--inventory-bench") == 0 && i + 2 < argc) {
+            benchDevices = max(atoi(argv[++i]), 1);
+            benchEvents = max(atoi(argv[++i]), 0);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = max(atof(argv[++i]), 0.0);
+        }
+#ifdef __linux__
+        else if (strcmp(argv[i], "--sysfs-root") == 0 && i + 1 < argc) {
+            return print_sysfs_tree(argv[++i]);
+        } else if (strcmp(argv[i], "--sysfs-bench") == 0 && i + 1 < argc) {
+            return sysfs_benchmark(max(atoi(argv[++i]), 1));
+        } else if (strcmp(argv[i], "--sysfs-selftest") == 0 && i + 1 < argc) {
+            return sysfs_selftest(max(atoi(argv[++i]), 1));
+        }
+#endif
+    }
+    if (benchDevices > 0) {
+        return inventory_benchmark(benchDevices, benchEvents, rate, workers, timeoutMs);
+    }
+
     libusb_context* ctx = nullptr;
     libusb_device** devs = nullptr;
 
@@ -93,6 +476,10 @@ int main(void)
         return 1;
     }
 
+    if (monitor) {
+        return monitor_devices(ctx, workers, timeoutMs);
+    }
+
     int count = libusb_get_device_list(ctx, &devs);    
     if (count < 0) {
         cerr << "Ошибка получения списка устройств: " << libusb_error_name(result) << endl;
@@ -102,8 +489,22 @@ int main(void)
 
     cout << "Найдено USB устройств: " << count << "\n" << endl;
 
+#ifdef __linux__
+    SysfsUsbScanner scanner;
+    useSysfs = useSysfs && scanner.available();
+    if (useSysfs) {
+        scanner.scan();
+    }
+#endif
+
     for (int i = 0; i < count; ++i) {
-        print_device(devs[i]);
+        const UsbDeviceInfo* info = nullptr;
+#ifdef __linux__
+        if (useSysfs) {
+            info = scanner.find(LibusbBackend::deviceName(devs[i]));
+        }
+#endif
+        print_device(devs[i], info);
     }
 
     libusb_free_device_list(devs, 1);
@@ -0,0 +1,37 @@
+#ifndef LAB6_USB_DEVICE_H
+#define LAB6_USB_DEVICE_H
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Сведения об устройстве, общие для всех способов перечисления. name -
+ * путь по портам в нотации sysfs ("1-1.2", корневой хаб - "usb1"); он не
+ * меняется при переподключении в тот же порт и служит ключом инвентаря.
+ */
+struct UsbDeviceInfo {
+    std::string name;
+    int busnum = 0;
+    int devnum = 0;
+    uint16_t idVendor = 0;
+    uint16_t idProduct = 0;
+    uint8_t deviceClass = 0;
+    bool hasSerial = false;
+    std::string serial;
+    std::string manufacturer;
+    std::string product;
+};
+
+/* Имя каталога sysfs по номеру шины и цепочке портов (как в libusb_get_port_numbers). */
+inline std::string sysfsDeviceName(int busnum, const uint8_t* ports, int depth) {
+    if (depth == 0) {
+        return "usb" + std::to_string(busnum);
+    }
+    std::string name = std::to_string(busnum) + "-" + std::to_string(ports[0]);
+    for (int i = 1; i < depth; ++i) {
+        name += "." + std::to_string(ports[i]);
+    }
+    return name;
+}
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef LAB6_USB_INVENTORY_H
+#define LAB6_USB_INVENTORY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "usb_device.h"
+
+/*
+ * Долгоживущий инвентарь USB. Сначала один параллельный скан: чтение
+ * дескрипторов раздаётся пулу рабочих потоков, и устройство, которое не
+ * ответило за timeoutMs, помечается зависшим - скан идёт дальше без него,
+ * а вместо застрявшего потока запускается новый. Затем инвентарь
+ * обновляется по событиям подключения/отключения от источника (libusb
+ * hotplug или имитация), без повторных сканов. Зависшие устройства
+ * перечитываются между событиями с удваивающейся паузой, пока не ответят,
+ * не отключатся или не придут событием подключения.
+ *
+ * Подписка на события делается до скана, поэтому устройство, подключённое
+ * во время скана, не теряется: событие подождёт в очереди, а повторное
+ * добавление уже найденного устройства просто перезапишет запись.
+ */
+
+enum UsbEventType { USB_ARRIVED, USB_LEFT };
+
+struct UsbEvent {
+    UsbEventType type = USB_ARRIVED;
+    UsbDeviceInfo info;
+    std::chrono::steady_clock::time_point emitted;
+};
+
+/* Очередь событий от источника к сервису; close() - событий больше не будет. */
+class UsbEventQueue {
+public:
+    void push(UsbEvent&& event) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            events.push_back(std::move(event));
+        }
+        ready.notify_one();
+    }
+
+    bool pop(UsbEvent& event, int timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !events.empty() || closed; });
+        if (events.empty()) {
+            return false;
+        }
+        event = std::move(events.front());
+        events.pop_front();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        ready.notify_all();
+    }
+
+    bool drained() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return closed && events.empty();
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<UsbEvent> events;
+    bool closed = false;
+};
+
+class UsbBackend {
+public:
+    virtual ~UsbBackend() {}
+    /* Имена устройств, подключённых сейчас. */
+    virtual std::vector<std::string> listDevices() = 0;
+    /* Чтение дескрипторов; может зависнуть на неисправном устройстве, вызывается из рабочих потоков. */
+    virtual bool readDevice(const std::string& name, UsbDeviceInfo& info) = 0;
+    /* Включает доставку событий; false - источник их не поддерживает. */
+    virtual bool subscribe() = 0;
+    /* Следующее событие, ожидание не дольше timeoutMs. */
+    virtual bool nextEvent(UsbEvent& event, int timeoutMs) = 0;
+    /* Событий больше не будет (конец записанного потока). */
+    virtual bool exhausted() const {
+        return false;
+    }
+};
+
+class UsbInventory {
+public:
+    void set(const UsbDeviceInfo& info) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        devices[info.name] = info;
+        ++changes;
+    }
+
+    bool remove(const std::string& name) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        bool removed = devices.erase(name) > 0;
+        changes += removed;
+        return removed;
+    }
+
+    bool find(const std::string& name, UsbDeviceInfo& info) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = devices.find(name);
+        if (it == devices.end()) {
+            return false;
+        }
+        info = it->second;
+        return true;
+    }
+
+    std::vector<UsbDeviceInfo> snapshot() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<UsbDeviceInfo> result;
+        result.reserve(devices.size());
+        for (const auto& entry : devices) {
+            result.push_back(entry.second);
+        }
+        return result;
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return devices.size();
+    }
+
+    /* Число изменений с момента создания. */
+    uint64_t version() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return changes;
+    }
+
+private:
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string, UsbDeviceInfo> devices;
+    uint64_t changes = 0;
+};
+
+struct ScanReport {
+    size_t devices = 0;
+    size_t read = 0;
+    size_t failed = 0;
+    size_t timedOut = 0;
+    double seconds = 0;
+    /* Имена устройств, не ответивших за тайм-аут. */
+    std::vector<std::string> hung;
+};
+
+/*
+ * Параллельное чтение устройств names в инвентарь. Состояние скана живёт в
+ * shared_ptr, который держат и рабочие потоки вместе с источником: зависший
+ * поток отсоединён и может вернуться когда угодно позже, его результат тогда
+ * просто отбрасывается, а источник живёт, пока не вернётся последний из них.
+ */
+inline ScanReport parallelRead(const std::shared_ptr<UsbBackend>& backend, std::vector<std::string> names,
+    UsbInventory& inventory, int workers, int timeoutMs) {
+    enum TaskState { TASK_PENDING, TASK_RUNNING, TASK_DONE, TASK_FAILED, TASK_TIMED_OUT };
+    struct Task {
+        std::string name;
+        UsbDeviceInfo info;
+        TaskState state = TASK_PENDING;
+        std::chrono::steady_clock::time_point started;
+    };
+    struct State {
+        std::shared_ptr<UsbBackend> backend;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<Task> tasks;
+        size_t next = 0;
+        size_t finished = 0;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto state = std::make_shared<State>();
+    state->backend = backend;
+    for (std::string& name : names) {
+        state->tasks.emplace_back();
+        state->tasks.back().name = std::move(name);
+    }
+
+    auto worker = [state] {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        while (state->next < state->tasks.size()) {
+            size_t i = state->next++;
+            Task& task = state->tasks[i];
+            task.state = TASK_RUNNING;
+            task.started = std::chrono::steady_clock::now();
+            std::string name = task.name;
+            lock.unlock();
+            UsbDeviceInfo info;
+            bool ok = state->backend->readDevice(name, info);
+            lock.lock();
+            if (task.state != TASK_RUNNING) {
+                return; // задачу уже списали по тайм-ауту, на её место запущен другой поток
+            }
+            task.state = ok ? TASK_DONE : TASK_FAILED;
+            task.info = std::move(info);
+            ++state->finished;
+            state->changed.notify_all();
+        }
+    };
+
+    ScanReport report;
+    report.devices = state->tasks.size();
+    size_t threads = std::min<size_t>(std::max(workers, 1), state->tasks.size());
+    for (size_t t = 0; t < threads; ++t) {
+        std::thread(worker).detach();
+    }
+
+    const auto timeout = std::chrono::milliseconds(timeoutMs);
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (state->finished < state->tasks.size()) {
+        auto now = std::chrono::steady_clock::now();
+        auto deadline = now + timeout;
+        for (Task& task : state->tasks) {
+            if (task.state != TASK_RUNNING) {
+                continue;
+            }
+            if (now - task.started >= timeout) {
+                task.state = TASK_TIMED_OUT;
+                ++state->finished;
+                ++report.timedOut;
+                std::thread(worker).detach();
+            } else {
+                deadline = std::min(deadline, task.started + timeout);
+            }
+        }
+        if (state->finished < state->tasks.size()) {
+            state->changed.wait_until(lock, deadline);
+        }
+    }
+    for (Task& task : state->tasks) {
+        if (task.state == TASK_DONE) {
+            inventory.set(task.info);
+            ++report.read;
+        } else if (task.state == TASK_FAILED) {
+            ++report.failed;
+        } else {
+            report.hung.push_back(task.name);
+        }
+    }
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+inline ScanReport parallelScan(const std::shared_ptr<UsbBackend>& backend, UsbInventory& inventory, int workers,
+    int timeoutMs) {
+    return parallelRead(backend, backend->listDevices(), inventory, workers, timeoutMs);
+}
+
+struct EventStats {
+    size_t events = 0;
+    size_t arrivals = 0;
+    size_t departures = 0;
+    /* Повторные чтения зависших устройств и сколько из них ответило. */
+    size_t retries = 0;
+    size_t recovered = 0;
+    /* Задержка от выдачи события источником до обновления инвентаря, нс. */
+    std::vector<int64_t> latencyNs;
+};
+
+class InventoryService {
+public:
+    InventoryService(std::shared_ptr<UsbBackend> backend, int workers, int timeoutMs)
+        : backend(std::move(backend)), workers(workers), timeoutMs(timeoutMs) {}
+
+    /* Подписка на события и начальный параллельный скан; subscribed() - удалась ли подписка. */
+    ScanReport start() {
+        events = backend->subscribe();
+        ScanReport report = parallelScan(backend, devices, workers, timeoutMs);
+        hung = report.hung;
+        retryDelay = std::chrono::milliseconds(timeoutMs);
+        nextRetry = std::chrono::steady_clock::now() + retryDelay;
+        return report;
+    }
+
+    bool subscribed() const {
+        return events;
+    }
+
+    /*
+     * Применяет события, пока running и источник не исчерпан; onChange
+     * вызывается после каждого. Повторное чтение зависших задерживает
+     * события не дольше чем на timeoutMs, они ждут в очереди источника.
+     */
+    void run(const std::atomic<bool>& running, const std::function<void(const UsbEvent&)>& onChange = nullptr) {
+        UsbEvent event;
+        while (events && running.load(std::memory_order_relaxed) && !backend->exhausted()) {
+            if (!hung.empty() && std::chrono::steady_clock::now() >= nextRetry) {
+                retryHung();
+            }
+            if (!backend->nextEvent(event, 100)) {
+                continue;
+            }
+            hung.erase(std::remove(hung.begin(), hung.end(), event.info.name), hung.end());
+            if (event.type == USB_ARRIVED) {
+                devices.set(event.info);
+                ++eventStats.arrivals;
+            } else {
+                devices.remove(event.info.name);
+                ++eventStats.departures;
+            }
+            ++eventStats.events;
+            eventStats.latencyNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - event.emitted).count());
+            if (onChange) {
+                onChange(event);
+            }
+        }
+    }
+
+    const UsbInventory& inventory() const {
+        return devices;
+    }
+
+    const EventStats& stats() const {
+        return eventStats;
+    }
+
+    /* Устройства, которые пока так и не ответили. */
+    size_t hungDevices() const {
+        return hung.size();
+    }
+
+private:
+    void retryHung() {
+        eventStats.retries += hung.size();
+        ScanReport report = parallelRead(backend, hung, devices, workers, timeoutMs);
+        eventStats.recovered += report.read;
+        hung = std::move(report.hung);
+        retryDelay = std::min(retryDelay * 2, std::chrono::milliseconds(MAX_RETRY_DELAY_MS));
+        nextRetry = std::chrono::steady_clock::now() + retryDelay;
+    }
+
+    static const int MAX_RETRY_DELAY_MS = 60000;
+
+    std::shared_ptr<UsbBackend> backend;
+    int workers;
+    int timeoutMs;
+    bool events = false;
+    UsbInventory devices;
+    EventStats eventStats;
+    std::vector<std::string> hung;
+    std::chrono::milliseconds retryDelay{0};
+    std::chrono::steady_clock::time_point nextRetry;
+};
+
+#endif
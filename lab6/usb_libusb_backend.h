@@ -0,0 +1,215 @@
+#ifndef LAB6_USB_LIBUSB_BACKEND_H
+#define LAB6_USB_LIBUSB_BACKEND_H
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <libusb.h>
+#include "usb_inventory.h"
+
+#ifdef __linux__
+#include "usb_sysfs.h"
+#endif
+
+/*
+ * Источник инвентаря на libusb. Устройства запоминаются по имени с лишней
+ * ссылкой (libusb_ref_device), чтобы рабочий поток мог читать устройство,
+ * даже если его уже отключили. События приходят из hotplug-обработчика,
+ * который libusb вызывает внутри libusb_handle_events - то есть в потоке,
+ * вызвавшем nextEvent. В обработчике нельзя открывать устройство, поэтому
+ * серийный номер для подключённых устройств берётся только из sysfs.
+ * При отключении запись удаляется и лишняя ссылка снимается.
+ *
+ * На Linux дескрипторы берутся из одного долгоживущего SysfsUsbScanner:
+ * listDevices() прогревает его кэш одним проходом, а чтения рабочих потоков
+ * и события подключения идут через lookup() (один файл devnum на известное
+ * устройство). Сканер защищён своим мьютексом - чтения sysfs короткие.
+ *
+ * Источник владеет контекстом и закрывает его в деструкторе: зависшие
+ * рабочие потоки скана держат shared_ptr на источник, поэтому libusb_exit
+ * выполнится только после того, как вернётся последний из них.
+ */
+class LibusbBackend : public UsbBackend {
+public:
+    explicit LibusbBackend(libusb_context* ctx) : ctx(ctx) {}
+
+    ~LibusbBackend() override {
+        if (registered) {
+            libusb_hotplug_deregister_callback(ctx, callback);
+        }
+        for (auto& entry : devices) {
+            libusb_unref_device(entry.second);
+        }
+        libusb_exit(ctx);
+    }
+
+    LibusbBackend(const LibusbBackend&) = delete;
+    LibusbBackend& operator=(const LibusbBackend&) = delete;
+
+    static std::string deviceName(libusb_device* dev) {
+        uint8_t ports[8];
+        int depth = libusb_get_port_numbers(dev, ports, sizeof(ports));
+        return sysfsDeviceName(libusb_get_bus_number(dev), ports, depth < 0 ? 0 : depth);
+    }
+
+    std::vector<std::string> listDevices() override {
+        std::vector<std::string> names;
+        libusb_device** list = nullptr;
+        ssize_t count = libusb_get_device_list(ctx, &list);
+        if (count < 0) {
+            return names;
+        }
+#ifdef __linux__
+        {
+            std::lock_guard<std::mutex> lock(sysfsMutex);
+            sysfs.scan();
+        }
+#endif
+        std::lock_guard<std::mutex> lock(mutex);
+        for (ssize_t i = 0; i < count; ++i) {
+            std::string name = deviceName(list[i]);
+            remember(name, list[i]);
+            names.push_back(name);
+        }
+        libusb_free_device_list(list, 1);
+        return names;
+    }
+
+    bool readDevice(const std::string& name, UsbDeviceInfo& info) override {
+        libusb_device* dev = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = devices.find(name);
+            if (it == devices.end()) {
+                return false;
+            }
+            dev = libusb_ref_device(it->second);
+        }
+        bool ok = describe(dev, name, info, true);
+        libusb_unref_device(dev);
+        return ok;
+    }
+
+    bool subscribe() override {
+        if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+            return false;
+        }
+        int result = libusb_hotplug_register_callback(ctx,
+            static_cast<libusb_hotplug_event>(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+            LIBUSB_HOTPLUG_NO_FLAGS, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, onHotplug, this, &callback);
+        registered = result == LIBUSB_SUCCESS;
+        return registered;
+    }
+
+    bool nextEvent(UsbEvent& event, int timeoutMs) override {
+        if (queue.pop(event, 0)) {
+            return true;
+        }
+        timeval tv = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+        libusb_handle_events_timeout_completed(ctx, &tv, nullptr);
+        return queue.pop(event, 0);
+    }
+
+#ifdef __linux__
+    /* Счётчики обращений к кэшу sysfs. */
+    SysfsScanStats sysfsStats() {
+        std::lock_guard<std::mutex> lock(sysfsMutex);
+        return sysfs.lookupStats();
+    }
+#endif
+
+private:
+    /* Вызывать под mutex. */
+    void remember(const std::string& name, libusb_device* dev) {
+        auto it = devices.find(name);
+        if (it != devices.end()) {
+            if (it->second == dev) {
+                return;
+            }
+            libusb_unref_device(it->second);
+        }
+        devices[name] = libusb_ref_device(dev);
+    }
+
+    /* Вызывать под mutex. Рабочий поток, читающий устройство, держит свою ссылку. */
+    void forget(const std::string& name) {
+        auto it = devices.find(name);
+        if (it != devices.end()) {
+            libusb_unref_device(it->second);
+            devices.erase(it);
+        }
+    }
+
+    /* Дескриптор без открытия; за серийным номером - в sysfs, а если его там нет и можно - в само устройство. */
+    bool describe(libusb_device* dev, const std::string& name, UsbDeviceInfo& info, bool allowOpen) {
+#ifdef __linux__
+        {
+            std::lock_guard<std::mutex> lock(sysfsMutex);
+            if (sysfs.lookup(name, info) && info.hasSerial) {
+                return true;
+            }
+        }
+#endif
+        libusb_device_descriptor desc{};
+        if (libusb_get_device_descriptor(dev, &desc) < 0) {
+            return false;
+        }
+        info.name = name;
+        info.busnum = libusb_get_bus_number(dev);
+        info.devnum = libusb_get_device_address(dev);
+        info.idVendor = desc.idVendor;
+        info.idProduct = desc.idProduct;
+        info.deviceClass = desc.bDeviceClass;
+        if (desc.iSerialNumber == 0 || !allowOpen) {
+            return true;
+        }
+        libusb_device_handle* handle = nullptr;
+        if (libusb_open(dev, &handle) == 0 && handle != nullptr) {
+            unsigned char serial[256];
+            int length = libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, serial, sizeof(serial));
+            if (length > 0) {
+                info.hasSerial = true;
+                info.serial.assign(reinterpret_cast<char*>(serial), length);
+            }
+            libusb_close(handle);
+        }
+        return true;
+    }
+
+    static int onHotplug(libusb_context*, libusb_device* dev, libusb_hotplug_event type, void* user) {
+        LibusbBackend* self = static_cast<LibusbBackend*>(user);
+        UsbEvent event;
+        event.emitted = std::chrono::steady_clock::now();
+        event.info.name = deviceName(dev);
+        if (type == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+            event.type = USB_ARRIVED;
+            self->describe(dev, event.info.name, event.info, false);
+            std::lock_guard<std::mutex> lock(self->mutex);
+            self->remember(event.info.name, dev);
+        } else {
+            event.type = USB_LEFT;
+            std::lock_guard<std::mutex> lock(self->mutex);
+            self->forget(event.info.name);
+#ifdef __linux__
+            std::lock_guard<std::mutex> sysfsLock(self->sysfsMutex);
+            self->sysfs.forget(event.info.name);
+#endif
+        }
+        self->queue.push(std::move(event));
+        return 0;
+    }
+
+    libusb_context* ctx;
+    std::mutex mutex;
+    std::unordered_map<std::string, libusb_device*> devices;
+    libusb_hotplug_callback_handle callback = 0;
+    bool registered = false;
+    UsbEventQueue queue;
+#ifdef __linux__
+    std::mutex sysfsMutex;
+    SysfsUsbScanner sysfs;
+#endif
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef LAB6_USB_MOCK_BACKEND_H
+#define LAB6_USB_MOCK_BACKEND_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "usb_inventory.h"
+
+/*
+ * Имитация USB без оборудования. Начальный набор из count устройств;
+ * чтение устройства занимает readDelayUs, а каждое hungEvery-е устройство
+ * при первом чтении "зависает" на hangMs (0 - зависших нет), повторное
+ * чтение проходит сразу. startReplay() запускает поток,
+ * который проигрывает заранее сгенерированный поток событий: подключение
+ * нового устройства или отключение случайного из подключённых, с заданной
+ * частотой (0 - без пауз). Запуск отделён от subscribe(), чтобы замер
+ * событий не включал время начального скана. Момент выдачи события
+ * ставится при помещении в очередь, так что задержка сервиса включает
+ * ожидание в очереди.
+ */
+class MockUsbBackend : public UsbBackend {
+public:
+    MockUsbBackend(int count, int readDelayUs, int hungEvery, int hangMs)
+        : readDelayUs(readDelayUs), hungEvery(hungEvery), hangMs(hangMs) {
+        for (int i = 0; i < count; ++i) {
+            UsbDeviceInfo info = makeDevice(i);
+            initial.push_back(info.name);
+            known[info.name] = i;
+        }
+        nextIndex = count;
+    }
+
+    ~MockUsbBackend() override {
+        stopReplay = true;
+        if (player.joinable()) {
+            player.join();
+        }
+    }
+
+    /* Готовит поток из events событий с частотой rate в секунду; вызывать до startReplay(). */
+    void prepareReplay(size_t events, double rate, unsigned seed = 12345) {
+        replayRate = rate;
+        std::mt19937 random(seed);
+        std::vector<std::string> present = initial;
+        script.clear();
+        script.reserve(events);
+        for (size_t e = 0; e < events; ++e) {
+            UsbEvent event;
+            if (!present.empty() && random() % 2 == 0) {
+                size_t victim = random() % present.size();
+                event.type = USB_LEFT;
+                event.info.name = present[victim];
+                present[victim] = present.back();
+                present.pop_back();
+            } else {
+                event.type = USB_ARRIVED;
+                event.info = makeDevice(nextIndex++);
+                present.push_back(event.info.name);
+            }
+            script.push_back(std::move(event));
+        }
+    }
+
+    std::vector<std::string> listDevices() override {
+        return initial;
+    }
+
+    bool readDevice(const std::string& name, UsbDeviceInfo& info) override {
+        auto it = known.find(name);
+        if (it == known.end()) {
+            return false;
+        }
+        const int index = it->second;
+        std::this_thread::sleep_for(std::chrono::microseconds(readDelayUs));
+        if (hungEvery > 0 && index % hungEvery == hungEvery - 1 && firstRead(index)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(hangMs));
+        }
+        info = makeDevice(index);
+        return true;
+    }
+
+    void startReplay() {
+        player = std::thread([this] { replay(); });
+    }
+
+    bool subscribe() override {
+        return true;
+    }
+
+    bool nextEvent(UsbEvent& event, int timeoutMs) override {
+        return queue.pop(event, timeoutMs);
+    }
+
+    bool exhausted() const override {
+        return queue.drained();
+    }
+
+    static UsbDeviceInfo makeDevice(int index) {
+        UsbDeviceInfo info;
+        info.busnum = 1 + index / 100;
+        info.devnum = 2 + index % 120;
+        info.name = std::to_string(info.busnum) + "-" + std::to_string(1 + index % 100 / 10) + "." +
+                    std::to_string(1 + index % 10);
+        info.idVendor = static_cast<uint16_t>(0x1000 + index);
+        info.idProduct = static_cast<uint16_t>(0x2000 + index % 64);
+        info.deviceClass = index % 3 == 0 ? 0x09 : 0x00;
+        info.hasSerial = index % 2 == 0;
+        if (info.hasSerial) {
+            info.serial = "SN" + std::to_string(100000 + index);
+        }
+        info.manufacturer = "Vendor " + std::to_string(index);
+        info.product = "Device " + std::to_string(index);
+        return info;
+    }
+
+private:
+    bool firstRead(int index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return readOnce.insert(index).second;
+    }
+
+    void replay() {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t e = 0; e < script.size() && !stopReplay; ++e) {
+            if (replayRate > 0) {
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(e / replayRate)));
+            }
+            script[e].emitted = std::chrono::steady_clock::now();
+            queue.push(std::move(script[e]));
+        }
+        queue.close();
+    }
+
+    int readDelayUs;
+    int hungEvery;
+    int hangMs;
+    std::vector<std::string> initial;
+    std::unordered_map<std::string, int> known;
+    std::mutex mutex;
+    std::unordered_set<int> readOnce;
+    int nextIndex = 0;
+    std::vector<UsbEvent> script;
+    double replayRate = 0;
+    std::atomic<bool> stopReplay{false};
+    std::thread player;
+    UsbEventQueue queue;
+};
+
+#endif
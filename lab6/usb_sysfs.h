@@ -0,0 +1,237 @@
+#ifndef LAB6_USB_SYSFS_H
+#define LAB6_USB_SYSFS_H
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "usb_device.h"
+
+/*
+ * Перечисление USB через sysfs без открытия устройств. Ядро уже прочитало
+ * дескрипторы при подключении и выложило их в /sys/bus/usb/devices/<имя>/
+ * текстовыми атрибутами (idVendor, idProduct, bDeviceClass, serial, ...),
+ * поэтому чтение - несколько маленьких read() и не требует прав на
+ * устройство, в отличие от libusb_open.
+ *
+ * Имя каталога - путь по портам ("1-1.2", корневой хаб - "usb1"). Устройство
+ * на том же порту после переподключения получает новый devnum, поэтому кэш
+ * хранит записи по имени вместе с busnum-devnum: при повторном скане для
+ * известного устройства читается один файл devnum, и если он не изменился,
+ * берётся запись из кэша. Записи пропавших устройств удаляются.
+ *
+ * Долгоживущий сканер (инвентарь, монитор) держит кэш между сканами и
+ * отвечает на вопросы об одном устройстве через lookup() с той же
+ * проверкой devnum. Сам сканер не потокобезопасен.
+ */
+
+struct SysfsScanStats {
+    size_t devices = 0;
+    size_t cacheHits = 0;
+    size_t fullReads = 0;
+    size_t removed = 0;
+};
+
+class SysfsUsbScanner {
+public:
+    explicit SysfsUsbScanner(const std::string& root = "/sys/bus/usb/devices") : root(root) {}
+
+    /* Есть ли каталог устройств (нет - не Linux или sysfs не смонтирован). */
+    bool available() const {
+        DIR* dir = opendir(root.c_str());
+        if (dir == nullptr) {
+            return false;
+        }
+        closedir(dir);
+        return true;
+    }
+
+    /* Полный проход по каталогу; результат действителен до следующего scan(). */
+    const std::vector<const UsbDeviceInfo*>& scan() {
+        current.clear();
+        lastStats = SysfsScanStats();
+        ++generation;
+        int rootFd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        DIR* dir = rootFd >= 0 ? fdopendir(rootFd) : nullptr;
+        if (dir == nullptr) {
+            if (rootFd >= 0) {
+                close(rootFd);
+            }
+            cache.clear();
+            return current;
+        }
+        while (dirent* entry = readdir(dir)) {
+            const char* name = entry->d_name;
+            // Интерфейсы ("1-1.2:1.0") и служебные записи пропускаются.
+            if (name[0] == '.' || strchr(name, ':') != nullptr) {
+                continue;
+            }
+            int fd = openat(rootFd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0) {
+                continue;
+            }
+            scanDevice(fd, name);
+            close(fd);
+        }
+        closedir(dir);
+        for (auto it = cache.begin(); it != cache.end();) {
+            if (it->second.seen != generation) {
+                it = cache.erase(it);
+                ++lastStats.removed;
+            } else {
+                ++it;
+            }
+        }
+        lastStats.devices = current.size();
+        return current;
+    }
+
+    /* Запись по имени каталога из последнего скана или nullptr. */
+    const UsbDeviceInfo* find(const std::string& name) const {
+        auto it = cache.find(name);
+        return it != cache.end() && it->second.seen == generation ? &it->second.info : nullptr;
+    }
+
+    const SysfsScanStats& stats() const {
+        return lastStats;
+    }
+
+    void clearCache() {
+        cache.clear();
+    }
+
+    /*
+     * Одно устройство по имени каталога через кэш: при том же devnum запись
+     * берётся из кэша, иначе читается целиком и кэшируется. Если каталога
+     * нет, запись удаляется. Счёт обращений - в lookupStats().
+     */
+    bool lookup(const std::string& name, UsbDeviceInfo& info) {
+        int fd = open((root + "/" + name).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            forget(name);
+            return false;
+        }
+        ++lookups.devices;
+        char buffer[256];
+        bool ok = readAttribute(fd, "devnum", buffer, sizeof(buffer));
+        if (ok) {
+            int devnum = atoi(buffer);
+            auto it = cache.find(name);
+            if (it != cache.end() && it->second.info.devnum == devnum) {
+                ++lookups.cacheHits;
+            } else {
+                Entry entry;
+                ok = readDevice(fd, name.c_str(), devnum, entry.info);
+                if (ok) {
+                    it = cache.insert_or_assign(name, std::move(entry)).first;
+                    ++lookups.fullReads;
+                }
+            }
+            if (ok) {
+                info = it->second.info;
+            }
+        }
+        close(fd);
+        return ok;
+    }
+
+    /* Удаляет запись отключённого устройства. */
+    void forget(const std::string& name) {
+        lookups.removed += cache.erase(name);
+    }
+
+    /* Счётчики lookup() и forget() с момента создания. */
+    const SysfsScanStats& lookupStats() const {
+        return lookups;
+    }
+
+private:
+    struct Entry {
+        UsbDeviceInfo info;
+        unsigned seen = 0;
+    };
+
+    void scanDevice(int fd, const char* name) {
+        char buffer[256];
+        if (!readAttribute(fd, "devnum", buffer, sizeof(buffer))) {
+            return;
+        }
+        int devnum = atoi(buffer);
+        auto it = cache.find(name);
+        if (it != cache.end() && it->second.info.devnum == devnum) {
+            ++lastStats.cacheHits;
+        } else {
+            Entry entry;
+            if (!readDevice(fd, name, devnum, entry.info)) {
+                return;
+            }
+            it = cache.insert_or_assign(name, std::move(entry)).first;
+            ++lastStats.fullReads;
+        }
+        it->second.seen = generation;
+        current.push_back(&it->second.info);
+    }
+
+    static bool readDevice(int fd, const char* name, int devnum, UsbDeviceInfo& info) {
+        char buffer[256];
+        if (!readAttribute(fd, "idVendor", buffer, sizeof(buffer))) {
+            return false;
+        }
+        info.idVendor = static_cast<uint16_t>(strtoul(buffer, nullptr, 16));
+        if (!readAttribute(fd, "idProduct", buffer, sizeof(buffer))) {
+            return false;
+        }
+        info.idProduct = static_cast<uint16_t>(strtoul(buffer, nullptr, 16));
+        if (readAttribute(fd, "bDeviceClass", buffer, sizeof(buffer))) {
+            info.deviceClass = static_cast<uint8_t>(strtoul(buffer, nullptr, 16));
+        }
+        if (readAttribute(fd, "busnum", buffer, sizeof(buffer))) {
+            info.busnum = atoi(buffer);
+        }
+        info.name = name;
+        info.devnum = devnum;
+        // Атрибута serial нет, если у устройства нет строки серийного номера.
+        info.hasSerial = readAttribute(fd, "serial", buffer, sizeof(buffer));
+        if (info.hasSerial) {
+            info.serial = buffer;
+        }
+        if (readAttribute(fd, "manufacturer", buffer, sizeof(buffer))) {
+            info.manufacturer = buffer;
+        }
+        if (readAttribute(fd, "product", buffer, sizeof(buffer))) {
+            info.product = buffer;
+        }
+        return true;
+    }
+
+    /* Значение атрибута без завершающего перевода строки. */
+    static bool readAttribute(int dirFd, const char* attribute, char* buffer, size_t size) {
+        int fd = openat(dirFd, attribute, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        ssize_t length = read(fd, buffer, size - 1);
+        close(fd);
+        if (length < 0) {
+            return false;
+        }
+        while (length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == '\0')) {
+            --length;
+        }
+        buffer[length] = '\0';
+        return true;
+    }
+
+    std::string root;
+    std::unordered_map<std::string, Entry> cache;
+    std::vector<const UsbDeviceInfo*> current;
+    SysfsScanStats lastStats;
+    SysfsScanStats lookups;
+    unsigned generation = 0;
+};
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef LAB7_BATCHED_INVERSE_H
+#define LAB7_BATCHED_INVERSE_H
+
+#include <algorithm>
+#include <cstring>
+#include "gemm.h"
+#include "thread_pool.h"
+
+/*
+ * Пакетное обращение множества маленьких матриц одного размера тем же
+ * методом, что и matrixConversion: B = A^T / (|A|_1 |A|_inf), R = I - BA,
+ * A^-1 ~ (I + R + ... + R^(M-1)) B.
+ *
+ * Матрицы хранятся чередованием (structure of arrays): пакет делится на
+ * группы по BATCH_LANES матриц, и элемент (i, j) всех матриц группы лежит
+ * подряд, образуя один вектор BatchVec. Любая операция над элементом
+ * выполняется сразу для всех матриц группы, поэтому циклы не зависят от
+ * ширины SIMD, а размер N известен компилятору для специализаций 8..128.
+ * Ядро собирается трижды (SSE, AVX2, AVX-512) с разными плитками умножения
+ * и выбирается по gemmActiveIsa().
+ */
+
+#define BATCH_INLINE inline __attribute__((always_inline))
+
+const size_t BATCH_LANES = 16;
+
+// Выравнивание задано явно: без -mavx512f GCC выравнивает такой тип только на 16.
+typedef float BatchVec __attribute__((vector_size(BATCH_LANES * sizeof(float)), aligned(64)));
+typedef int BatchMask __attribute__((vector_size(BATCH_LANES * sizeof(float))));
+
+inline size_t batchGroups(size_t count) {
+    return (count + BATCH_LANES - 1) / BATCH_LANES;
+}
+
+/* Число float, нужное для пакета count матриц N x N в чередующемся виде. */
+inline size_t batchStorage(size_t count, size_t N) {
+    return batchGroups(count) * N * N * BATCH_LANES;
+}
+
+/* Обычный массив count матриц подряд -> чередующийся вид; хвост группы заполняется нулями. */
+inline void batchInterleave(const float* matrices, float* batch, size_t count, size_t N) {
+    memset(batch, 0, batchStorage(count, N) * sizeof(float));
+    for (size_t m = 0; m < count; ++m) {
+        float* group = &batch[m / BATCH_LANES * N * N * BATCH_LANES + m % BATCH_LANES];
+        for (size_t e = 0; e < N * N; ++e) {
+            group[e * BATCH_LANES] = matrices[m * N * N + e];
+        }
+    }
+}
+
+inline void batchDeinterleave(const float* batch, float* matrices, size_t count, size_t N) {
+    for (size_t m = 0; m < count; ++m) {
+        const float* group = &batch[m / BATCH_LANES * N * N * BATCH_LANES + m % BATCH_LANES];
+        for (size_t e = 0; e < N * N; ++e) {
+            matrices[m * N * N + e] = group[e * BATCH_LANES];
+        }
+    }
+}
+
+// BatchVec передаётся только по ссылке: по значению 64-байтный вектор меняет ABI без AVX-512.
+BATCH_INLINE void batchAddAbs(BatchVec& sum, const BatchVec& v) {
+    sum += reinterpret_cast<BatchVec>(reinterpret_cast<const BatchMask&>(v) & 0x7fffffff);
+}
+
+/*
+ * C = A * B для группы матриц n x n плитками TR x TC векторов-аккумуляторов;
+ * при NT != 0 размер известен на этапе компиляции.
+ */
+template <size_t NT, size_t TR, size_t TC>
+BATCH_INLINE void batchMul(size_t n, const BatchVec* A, const BatchVec* B, BatchVec* C) {
+    const size_t N = NT ? NT : n;
+    const size_t rows = N / TR * TR;
+    const size_t cols = N / TC * TC;
+    for (size_t i = 0; i < rows; i += TR) {
+        for (size_t j = 0; j < cols; j += TC) {
+            BatchVec acc[TR][TC] = {};
+            for (size_t k = 0; k < N; ++k) {
+                const BatchVec* b = &B[k * N + j];
+#pragma GCC unroll 4
+                for (size_t r = 0; r < TR; ++r) {
+                    BatchVec a = A[(i + r) * N + k];
+#pragma GCC unroll 4
+                    for (size_t c = 0; c < TC; ++c) {
+                        acc[r][c] += a * b[c];
+                    }
+                }
+            }
+            for (size_t r = 0; r < TR; ++r) {
+                for (size_t c = 0; c < TC; ++c) {
+                    C[(i + r) * N + j + c] = acc[r][c];
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = i < rows ? cols : 0; j < N; ++j) {
+            BatchVec acc = {};
+            for (size_t k = 0; k < N; ++k) {
+                acc += A[i * N + k] * B[k * N + j];
+            }
+            C[i * N + j] = acc;
+        }
+    }
+}
+
+/* Обращает одну группу; work - не меньше 4 * n * n векторов. */
+template <size_t NT, size_t TR, size_t TC>
+BATCH_INLINE void batchInverseGroup(size_t n, const BatchVec* A, BatchVec* X, size_t M, BatchVec* work) {
+    const size_t N = NT ? NT : n;
+    BatchVec* B = work;
+    BatchVec* R = B + N * N;
+    BatchVec* power = R + N * N;
+    BatchVec* next = power + N * N;
+    BatchVec* sum = X;
+
+    BatchVec rowMax = BatchVec{};
+    BatchVec colMax = BatchVec{};
+    for (size_t i = 0; i < N; ++i) {
+        BatchVec row = BatchVec{};
+        BatchVec col = BatchVec{};
+        for (size_t j = 0; j < N; ++j) {
+            batchAddAbs(row, A[i * N + j]);
+            batchAddAbs(col, A[j * N + i]);
+        }
+        rowMax = row > rowMax ? row : rowMax;
+        colMax = col > colMax ? col : colMax;
+    }
+    BatchVec scale = rowMax * colMax;
+    scale = scale == 0 ? scale + 1 : scale;
+    BatchVec inv = 1 / scale;
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = 0; j < N; ++j) {
+            B[j * N + i] = A[i * N + j] * inv;
+        }
+    }
+
+    batchMul<NT, TR, TC>(N, B, A, R);
+    for (size_t e = 0; e < N * N; ++e) {
+        R[e] = -R[e];
+        sum[e] = BatchVec{};
+    }
+    for (size_t i = 0; i < N; ++i) {
+        R[i * N + i] += 1;
+        sum[i * N + i] += 1;
+    }
+
+    const BatchVec* term = R;
+    for (size_t i = 1; i < M; ++i) {
+        for (size_t e = 0; e < N * N; ++e) {
+            sum[e] += term[e];
+        }
+        if (i < M - 1) {
+            batchMul<NT, TR, TC>(N, term, R, power);
+            term = power;
+            std::swap(power, next);
+        }
+    }
+    batchMul<NT, TR, TC>(N, sum, B, R);
+    memcpy(X, R, N * N * sizeof(BatchVec));
+}
+
+template <size_t NT>
+void batchGroupSse(size_t n, const BatchVec* A, BatchVec* X, size_t M, BatchVec* work) {
+    batchInverseGroup<NT, 2, 1>(n, A, X, M, work);
+}
+
+template <size_t NT>
+__attribute__((target("avx2,fma")))
+void batchGroupAvx2(size_t n, const BatchVec* A, BatchVec* X, size_t M, BatchVec* work) {
+    batchInverseGroup<NT, 2, 2>(n, A, X, M, work);
+}
+
+template <size_t NT>
+__attribute__((target("avx512f")))
+void batchGroupAvx512(size_t n, const BatchVec* A, BatchVec* X, size_t M, BatchVec* work) {
+    batchInverseGroup<NT, 4, 4>(n, A, X, M, work);
+}
+
+template <size_t NT>
+void batchInverseAll(size_t N, const float* A, float* X, size_t count, size_t M) {
+    const size_t groupSize = N * N * BATCH_LANES;
+    void (*group)(size_t, const BatchVec*, BatchVec*, size_t, BatchVec*) =
+        gemmActiveIsa() == GEMM_AVX512 ? batchGroupAvx512<NT>
+        : gemmActiveIsa() == GEMM_AVX2 ? batchGroupAvx2<NT> : batchGroupSse<NT>;
+    threadPool().run(batchGroups(count), [&](size_t g) {
+        static thread_local GemmBuffer work;
+        group(N, reinterpret_cast<const BatchVec*>(&A[g * groupSize]),
+              reinterpret_cast<BatchVec*>(&X[g * groupSize]), M,
+              reinterpret_cast<BatchVec*>(work.get(4 * groupSize)));
+    });
+}
+
+/*
+ * Обращает count матриц N x N в чередующемся виде (см. batchInterleave),
+ * M - число членов ряда. A и X должны быть выровнены на sizeof(BatchVec).
+ */
+inline void batchedInverse(const float* A, float* X, size_t count, size_t N, size_t M) {
+    switch (N) {
+        case 8: batchInverseAll<8>(N, A, X, count, M); break;
+        case 16: batchInverseAll<16>(N, A, X, count, M); break;
+        case 32: batchInverseAll<32>(N, A, X, count, M); break;
+        case 64: batchInverseAll<64>(N, A, X, count, M); break;
+        case 128: batchInverseAll<128>(N, A, X, count, M); break;
+        default: batchInverseAll<0>(N, A, X, count, M); break;
+    }
+}
+
+#endif
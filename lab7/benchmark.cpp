@@ -0,0 +1,261 @@
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "matrix_ops.h"
+#include "tiled_matrix.h"
+
+using namespace std;
+
+/*
+ * Обращение матриц всеми реализациями MatrixOps на наборе размеров N:
+ * проверка по эталону scalar, таблицы GFLOP/s и ускорения относительно scalar.
+ * Сборка с CBLAS: g++ -O2 -pthread -DWITH_CBLAS benchmark.cpp -lopenblas.
+ * Порог Штрассена здесь по умолчанию 64 (--strassen-cutoff), чтобы и на
+ * размерах по умолчанию strassen проверялся с рекурсией в 1-3 уровня, а
+ * не сводился к обычному gemm. Размеры 30 и 101 не кратны ширине векторов
+ * и проверяют скалярные хвосты.
+ *
+ * С --out-of-core тот же ряд считается через tiled_matrix.h: матрицы лежат
+ * плитками в файлах каталога --dir, в памяти --depth плиток на чтение и
+ * столько же на запись плюс кэш строк A для умножения (--cache-mb). Для N,
+ * умещающихся в память, выводится сравнение с invertMatrix.
+ */
+
+void fillRandomMatrix(float* A, const size_t N, unsigned seed) {
+    mt19937 gen(seed);
+    uniform_real_distribution<float> dis(-10.0f, 10.0f);
+    for (size_t i = 0; i < N * N; ++i) {
+        A[i] = dis(gen);
+    }
+}
+
+float relativeDiff(const float* A, const float* ref, const size_t N) {
+    float diff = 0, scale = 0;
+    for (size_t i = 0; i < N * N; ++i) {
+        diff = max(diff, fabsf(A[i] - ref[i]));
+        scale = max(scale, fabsf(ref[i]));
+    }
+    return scale > 0 ? diff / scale : diff;
+}
+
+vector<size_t> parseSizes(const char* list) {
+    vector<size_t> sizes;
+    for (const char* p = list; *p;) {
+        char* end;
+        long n = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        if (n > 0) {
+            sizes.push_back(static_cast<size_t>(n));
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return sizes;
+}
+
+/* Случайная матрица прямо в файл, без матрицы N x N в памяти. */
+void fillRandomTiles(TiledMatrix& A, unsigned seed) {
+    mt19937 gen(seed);
+    uniform_real_distribution<float> dis(-10.0f, 10.0f);
+    const size_t T = A.tileSize();
+    vector<float> tile(A.tileFloats());
+    for (size_t ti = 0; ti < A.tileCount(); ++ti) {
+        for (size_t tj = 0; tj < A.tileCount(); ++tj) {
+            fill(tile.begin(), tile.end(), 0.0f);
+            for (size_t r = 0; r < A.rowsIn(ti); ++r) {
+                for (size_t c = 0; c < A.rowsIn(tj); ++c) {
+                    tile[r * T + c] = dis(gen);
+                }
+            }
+            A.writeTile(ti, tj, tile.data());
+        }
+    }
+}
+
+/* Один размер N; false - расхождение с invertMatrix больше tolerance. */
+bool outOfCoreRun(size_t N, size_t M, size_t tile, size_t depth, size_t cacheTiles, const string& dir, bool direct,
+                  size_t inMemoryLimit, float tolerance, int repeat) {
+    TiledMatrix A(dir + "/lab7_A.tiles", N, tile, direct);
+    TiledMatrix Res(dir + "/lab7_Res.tiles", N, tile, direct);
+    const bool inMemory = N <= inMemoryLimit;
+    vector<float> matrix, ref;
+    double memoryGflops = 0;
+    if (inMemory) {
+        matrix.resize(N * N);
+        ref.resize(N * N);
+        fillRandomMatrix(matrix.data(), N, static_cast<unsigned>(N));
+        double best = 1e300;
+        for (int r = 0; r < repeat; ++r) {
+            best = min(best, invertMatrix(matrixOpsDefault(), matrix.data(), ref.data(), N, M));
+        }
+        memoryGflops = 2.0 * N * N * N * M / best * 1e-9;
+        A.load(matrix.data());
+    } else {
+        fillRandomTiles(A, static_cast<unsigned>(N));
+    }
+
+    TiledStats& stats = tiledStats();
+    stats.bytesRead = 0;
+    stats.bytesWritten = 0;
+    stats.flops = 0;
+    stats.stallSeconds = 0;
+    auto start = chrono::steady_clock::now();
+    tiledInvert(A, Res, M, dir, depth, cacheTiles, direct);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << N << "\t";
+    if (inMemory) {
+        cout << memoryGflops;
+    } else {
+        cout << "-";
+    }
+    cout << "\t" << stats.flops / seconds * 1e-9
+         << "\t" << stats.bytesRead / seconds / (1 << 20) << "\t" << stats.bytesWritten / seconds / (1 << 20)
+         << "\t" << 100 * stats.stallSeconds / seconds << "\t" << tiledPanelRows(A.tileCount(), cacheTiles) << "\t";
+    if (inMemory) {
+        Res.store(matrix.data());
+        float diff = relativeDiff(matrix.data(), ref.data(), N);
+        cout << diff << endl;
+        return diff <= tolerance;
+    }
+    cout << "-" << endl;
+    return true;
+}
+
+int outOfCoreBenchmark(const vector<size_t>& sizes, size_t M, size_t tile, size_t depth, size_t cacheMb,
+                       const string& dir, bool direct, size_t inMemoryLimit, float tolerance, int repeat) {
+    const size_t tileBytes = tile * tile * sizeof(float);
+    const size_t cacheTiles = cacheMb * (1 << 20) / tileBytes;
+    cout << "Out-of-core: плитка " << tile << ", буферы чтения и записи " << 2 * depth << " плиток ("
+         << 2 * depth * tileBytes / (1 << 20) << " МБ), кэш строк A до " << cacheMb << " МБ, каталог " << dir
+         << (direct ? ", O_DIRECT" : "") << endl;
+    cout << "N	в памяти GFLOP/s	на диске GFLOP/s	чтение МБ/с	запись МБ/с	ожидание I/O %	строк A в кэше	расхождение"
+         << endl;
+    bool allCorrect = true;
+    for (size_t N : sizes) {
+        try {
+            if (!outOfCoreRun(N, M, tile, depth, cacheTiles, dir, direct, inMemoryLimit, tolerance, repeat)) {
+                allCorrect = false;
+            }
+        } catch (const exception& e) {
+            cerr << "Out-of-core, N = " << N << ": " << e.what() << endl;
+            return 1;
+        }
+    }
+    return allCorrect ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    vector<size_t> sizes = {30, 101, 128, 256, 512};
+    size_t M = 10;
+    int repeat = 3;
+    float tolerance = 1e-3f;
+    bool outOfCore = false;
+    bool direct = false;
+    size_t tile = 512;
+    size_t depth = 8;
+    size_t cacheMb = 1024;
+    size_t inMemoryLimit = 8192;
+    string dir = "/tmp";
+    strassenCutoff() = 64;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            sizes = parseSizes(argv[++i]);
+        } else if (strcmp(argv[i], "--terms") == 0 && i + 1 < argc) {
+            M = max(atoi(argv[++i]), 2);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadPool().resize(max(atoi(argv[++i]), 1));
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--out-of-core") == 0) {
+            outOfCore = true;
+        } else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+            tile = max(atoi(argv[++i]) / 32 * 32, 32);
+        } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            depth = max(atoi(argv[++i]), 3);
+        } else if (strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc) {
+            cacheMb = static_cast<size_t>(max(atoi(argv[++i]), 0));
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "--direct") == 0) {
+            direct = true;
+        } else if (strcmp(argv[i], "--in-memory-limit") == 0 && i + 1 < argc) {
+            inMemoryLimit = static_cast<size_t>(atol(argv[++i]));
+        } else if (strcmp(argv[i], "--strassen-cutoff") == 0 && i + 1 < argc) {
+            strassenCutoff() = max(atoi(argv[++i]), 16);
+        }
+    }
+#ifdef WITH_CBLAS
+    blas::useThreads(threadPool().size(), 1);
+#endif
+    if (outOfCore) {
+        return outOfCoreBenchmark(sizes, M, tile, depth, cacheMb, dir, direct, inMemoryLimit, tolerance, repeat);
+    }
+
+    size_t count;
+    const MatrixOps* list = matrixOpsList(count);
+    vector<const MatrixOps*> backends;
+    cout << "Реализации:";
+    for (size_t i = 0; i < count; ++i) {
+        if (list[i].supported()) {
+            backends.push_back(&list[i]);
+            cout << " " << list[i].name;
+        }
+    }
+    cout << "; по умолчанию " << matrixOpsDefault().name << ", потоков " << threadPool().size()
+         << ", порог Штрассена " << strassenCutoff() << endl;
+
+    // gflops[n][b], время - лучшее из repeat запусков.
+    vector<vector<double>> gflops(sizes.size(), vector<double>(backends.size()));
+    bool allCorrect = true;
+    for (size_t n = 0; n < sizes.size(); ++n) {
+        const size_t N = sizes[n];
+        float* A = new float[N * N];
+        float* ref = new float[N * N];
+        float* res = new float[N * N];
+        fillRandomMatrix(A, N, static_cast<unsigned>(N));
+        const double flops = 2.0 * N * N * N * M;
+        for (size_t b = 0; b < backends.size(); ++b) {
+            float* out = b == 0 ? ref : res;
+            double best = 1e300;
+            for (int r = 0; r < repeat; ++r) {
+                best = min(best, invertMatrix(*backends[b], A, out, N, M));
+            }
+            gflops[n][b] = flops / best * 1e-9;
+            if (b > 0) {
+                float diff = relativeDiff(res, ref, N);
+                if (!(diff <= tolerance)) {
+                    cerr << backends[b]->name << ", N = " << N << ": расхождение с scalar " << diff << endl;
+                    allCorrect = false;
+                }
+            }
+        }
+        delete[] A;
+        delete[] ref;
+        delete[] res;
+    }
+
+    for (int table = 0; table < 2; ++table) {
+        cout << endl << (table == 0 ? "GFLOP/s" : "Ускорение относительно scalar") << endl << "N";
+        for (const MatrixOps* ops : backends) {
+            cout << "\t" << ops->name;
+        }
+        cout << endl;
+        for (size_t n = 0; n < sizes.size(); ++n) {
+            cout << sizes[n];
+            for (size_t b = 0; b < backends.size(); ++b) {
+                cout << "\t" << (table == 0 ? gflops[n][b] : gflops[n][b] / gflops[n][0]);
+            }
+            cout << endl;
+        }
+    }
+    cout << endl << (allCorrect ? "Все реализации совпадают с scalar" : "Есть расхождения с scalar") << endl;
+    return allCorrect ? 0 : 1;
+}
@@ -1,112 +1,25 @@
 #include <cmath>
 #include <algorithm>
+#include <chrono>
 #include <ctime>
 #include <iostream>
 #include <climits>
 #include <cstring>
 #include <random>
-#include <cblas.h>
+#include <vector>
 
-using namespace std;
-
-void addMatrix(const float* A, const float* B, float* Res, const size_t N) {
-    cblas_scopy(N * N, A, 1, Res, 1);
-    cblas_saxpy(N * N, 1.0f, B, 1, Res, 1);
-}
-
-void subMatrix(const float* A, const float* B, float* Res, const size_t N) {
-    cblas_scopy(N * N, A, 1, Res, 1);
-    cblas_saxpy(N * N, -1.0f, B, 1, Res, 1);
-}
-
-void mulMatrix(const float* A, const float* B, float* Res, const size_t N) {
-    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
-                N, N, N,
-                1.0f,
-                A, N,
-                B, N,
-                0.0f,
-                Res, N);
-}
-
-
-void divMatrix(const float* A, float* Res, const float k, const size_t N) {
-    cblas_scopy(N * N, A, 1, Res, 1);
-    float inv_k = 1.0f / k;
-    cblas_sscal(N * N, inv_k, Res, 1);
-}
+// Сборка: g++ -O2 -pthread -DWITH_CBLAS blas.cpp -lopenblas (как и для benchmark.cpp).
+#ifndef WITH_CBLAS
+#error "blas.cpp требует -DWITH_CBLAS"
+#endif
+#include "matrix_ops.h"
 
-void transposeMatrix(const float* A, float* AT, const size_t N) {
-    for (size_t i = 0; i < N; ++i) {
-        cblas_scopy(N, &A[i * N], 1, &AT[i], N);
-    }
-}
-
-float findMaxAbsSumByRows(const float* A, const size_t N) {
-    float res = INT_MIN;
-    for (size_t i = 0; i < N; ++i) {
-        float sum = cblas_sasum(N, &A[i * N], 1);
-        res = max(sum, res);
-    }
-    return res;
-}
-
-float findMaxAbsSumByColumns(const float* A, const size_t N) {
-    float res = INT_MIN;
-    for (size_t i = 0; i < N; ++i) {
-        float sum = cblas_sasum(N, &A[i], N);
-        res = max(sum, res);
-    }
-    return res;
-}
+using namespace std;
 
-void initIdentityMatrix(float* Res, const size_t N) {
-    memset(Res, 0, N * N * sizeof(float));
-    for (size_t i = 0; i < N; ++i) {
-        Res[i * N + i] = 1.0f;
-    }
-}
+using blas::useThreads;
 
 double matrixConversion(float* A, float* Res, const size_t N, const size_t M) {
-    float* B = new float[N * N];
-    float* AT = new float[N * N];
-    float* R = new float[N * N];
-    float* identityMatrix = new float[N * N];
-    float* tmp = new float[N * N];
-    float* tmp2 = new float[N * N];
-
-    clock_t inversion_start = clock();
-    transposeMatrix(A, AT, N);
-    float scale = findMaxAbsSumByColumns(A, N) * findMaxAbsSumByRows(A, N);
-    divMatrix(AT, B, scale, N);
-
-    mulMatrix(B, A, tmp, N);
-    initIdentityMatrix(identityMatrix, N);
-    subMatrix(identityMatrix, tmp, R, N);
-
-    initIdentityMatrix(Res, N);
-    cblas_scopy(N * N, R, 1, tmp, 1);
-
-    for (size_t i = 1; i < M; ++i) {
-        cblas_saxpy(N * N, 1.0f, tmp, 1, Res, 1);
-        if (i < M - 1) {
-            mulMatrix(tmp, R, tmp2, N);
-            cblas_scopy(N * N, tmp2, 1, tmp, 1);
-        }
-    }
-    mulMatrix(Res, B, tmp, N);
-    cblas_scopy(N * N, tmp, 1, Res, 1);
-
-    clock_t inversion_end = clock();
-
-    delete[] B;
-    delete[] AT;
-    delete[] R;
-    delete[] identityMatrix;
-    delete[] tmp;
-    delete[] tmp2;
-
-    return static_cast<double>(inversion_end - inversion_start) / CLOCKS_PER_SEC;
+    return invertMatrix(*matrixOpsByName("blas"), A, Res, N, M);
 }
 
 void fillRandomMatrix(float* A, const size_t N) {
@@ -127,14 +40,71 @@ void printMatrix(const float* A, const size_t N) {
     }
 }
 
-int main(void) {
+size_t nextThreadCount(size_t threads, size_t maxThreads) {
+    return threads * 2 <= maxThreads || threads == maxThreads ? threads * 2 : maxThreads;
+}
+
+/*
+ * Сильная масштабируемость: обращение N x N на 1, 2, 4, ... maxThreads потоках
+ * пула (OpenBLAS однопоточный) и для сравнения - однопоточный пул с
+ * внутренними потоками OpenBLAS.
+ */
+void scalingBenchmark(const size_t N, const size_t M, size_t maxThreads) {
+    float* A = new float[N * N];
+    float* A_inv = new float[N * N];
+    fillRandomMatrix(A, N);
+    cout << "Потоки\tВремя, с\tУскорение\tЭффективность" << endl;
+    double single = 0;
+    for (size_t threads = 1; threads <= maxThreads; threads = nextThreadCount(threads, maxThreads)) {
+        useThreads(threads, 1);
+        double time = matrixConversion(A, A_inv, N, M);
+        if (threads == 1) {
+            single = time;
+        }
+        cout << threads << "\t" << time << "\t" << single / time << "\t" << single / time / threads << endl;
+    }
+    useThreads(1, maxThreads);
+    double time = matrixConversion(A, A_inv, N, M);
+    cout << "OpenBLAS x" << maxThreads << "\t" << time << "\t" << single / time << "\t"
+         << single / time / maxThreads << endl;
+    delete[] A;
+    delete[] A_inv;
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxThreads = threadPool().size();
+    bool scaling = false;
+    int repeat = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            maxThreads = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        } else if (strcmp(argv[i], "--huge-pages") == 0) {
+            workspace().setHugePages(true);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = max(atoi(argv[++i]), 1);
+        }
+    }
     const size_t N = 2048;
     const size_t M = 10;
+    if (scaling) {
+        scalingBenchmark(N, M, maxThreads);
+        return 0;
+    }
+    useThreads(maxThreads, 1);
     float* A = new float[N * N];
     float* A_inv = new float[N * N];
     fillRandomMatrix(A, N);
-    double inversion_time = matrixConversion(A, A_inv, N, M);
-    cout << "Время обращения: " << inversion_time << " sec " << endl;
+    auto prepare_start = chrono::steady_clock::now();
+    workspace().reserve(OPS_COUNT, N);
+    double prepare_time = chrono::duration<double>(chrono::steady_clock::now() - prepare_start).count();
+    cout << "Рабочая область: " << workspace().bytes() / (1024 * 1024) << " МБ (" << workspace().backing()
+         << "), выделение и заполнение страниц: " << prepare_time << " sec (вынесено из замера)" << endl;
+    for (int r = 0; r < repeat; ++r) {
+        double inversion_time = matrixConversion(A, A_inv, N, M);
+        cout << "Время обращения: " << inversion_time << " sec " << endl;
+    }
     delete[] A;
     delete[] A_inv;
     cout << "Программа завершена." << endl;
@@ -1,33 +1,34 @@
 #include <cmath>
 #include <algorithm>
+#include <chrono>
 #include <ctime>
 #include <iostream>
 #include <climits>
 #include <cstring>
 #include <random>
+#include <string>
+#include <vector>
 #include <immintrin.h>
+#include "batched_inverse.h"
+#include "gemm.h"
+#include "ops_sse.h"
+#include "strassen.h"
+#include "workspace.h"
+#ifdef WITH_CBLAS
+#include <cblas.h>
+#endif
 
 using namespace std;
 
-void addMatrix(const float* A, const float* B, float* Res, const size_t N) {
-    for (size_t i = 0; i < N * N; i += 4) {
-        __m128 vecA = _mm_loadu_ps(&A[i]);
-        __m128 vecB = _mm_loadu_ps(&B[i]);
-        __m128 vecRes = _mm_add_ps(vecA, vecB);
-        _mm_storeu_ps(&Res[i], vecRes);
-    }
-}
-
-void subMatrix(const float* A, const float* B, float* Res, const size_t N) {
-    for (size_t i = 0; i < N * N; i += 4) {
-        __m128 vecA = _mm_loadu_ps(&A[i]);
-        __m128 vecB = _mm_loadu_ps(&B[i]);
-        __m128 vecRes = _mm_sub_ps(vecA, vecB);
-        _mm_storeu_ps(&Res[i], vecRes);
-    }
-}
+using sse::addMatrix;
+using sse::subMatrix;
+using sse::divMatrix;
+using sse::transposeMatrix;
+using sse::findMaxAbsSumByRows;
+using sse::findMaxAbsSumByColumns;
+using sse::initIdentityMatrix;
 
-void mulMatrix(const float* A, const float* B, float* Res, const size_t N) {
+void mulMatrixBlocked(const float* A, const float* B, float* Res, const size_t N) {
     const size_t blockSize = 64;
     memset(Res, 0, N * N * sizeof(float));
     for (size_t i = 0; i < N; i += blockSize) {
@@ -49,123 +50,251 @@ void mulMatrix(const float* A, const float* B, float* Res, const size_t N) {
     }
 }
 
-void divMatrix(const float* A, float* Res, const float k, const size_t N) {
-    __m128 vecK = _mm_set1_ps(k);
-    for (size_t i = 0; i < N * N; i += 4) {
-        __m128 vecA = _mm_loadu_ps(&A[i]);
-        __m128 vecRes = _mm_div_ps(vecA, vecK);
-        _mm_storeu_ps(&Res[i], vecRes);
-    }
-}
-
-void transposeMatrix(const float* A, float* AT, const size_t N) {
-    for (size_t i = 0; i < N; i += 4) {
-        for (size_t j = 0; j < N; j += 4) {
-            __m128 row0 = _mm_loadu_ps(&A[i * N + j]);
-            __m128 row1 = _mm_loadu_ps(&A[(i + 1) * N + j]);
-            __m128 row2 = _mm_loadu_ps(&A[(i + 2) * N + j]);
-            __m128 row3 = _mm_loadu_ps(&A[(i + 3) * N + j]);
-            
-            __m128 tmp0 = _mm_unpacklo_ps(row0, row1);
-            __m128 tmp1 = _mm_unpackhi_ps(row0, row1);
-            __m128 tmp2 = _mm_unpacklo_ps(row2, row3);
-            __m128 tmp3 = _mm_unpackhi_ps(row2, row3);
-            
-            _mm_storeu_ps(&AT[j * N + i], _mm_movelh_ps(tmp0, tmp2));
-            _mm_storeu_ps(&AT[(j + 1) * N + i], _mm_movehl_ps(tmp2, tmp0));
-            _mm_storeu_ps(&AT[(j + 2) * N + i], _mm_movelh_ps(tmp1, tmp3));
-            _mm_storeu_ps(&AT[(j + 3) * N + i], _mm_movehl_ps(tmp3, tmp1));
-        }
-    }
-}
-
-float findMaxAbsSumByRows(const float* A, const size_t N) {
-    float res = INT_MIN;
-    for (size_t i = 0; i < N; ++i) {
-        __m128 vecSum = _mm_setzero_ps();
-        size_t j = 0;
-        for (; j + 3 < N; j += 4) {
-            __m128 vecA = _mm_loadu_ps(&A[i * N + j]);
-            vecA = _mm_andnot_ps(_mm_set1_ps(-0.0f), vecA);
-            vecSum = _mm_add_ps(vecSum, vecA);
-        }
-        float sumArr[4];
-        _mm_storeu_ps(sumArr, vecSum);
-        float sum = sumArr[0] + sumArr[1] + sumArr[2] + sumArr[3];
-        for (; j < N; ++j) {
-            sum += fabsf(A[i * N + j]);
-        }
-        res = max(sum, res);
+// --strassen: умножение по Штрассену-Винограду выше порога strassenCutoff().
+bool useStrassen = false;
+
+void mulMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    if (useStrassen) {
+        strassenMul(A, B, Res, N, strassenCutoff());
+    } else {
+        gemm(N, N, N, A, N, B, N, Res, N);
     }
-    return res;
 }
 
-float findMaxAbsSumByColumns(const float* A, const size_t N) {
-    float res = INT_MIN;
-    for (size_t i = 0; i < N; ++i) {
-        __m128 vecSum = _mm_setzero_ps();
-        for (size_t j; j + 3 < N; j += 4) {
-            __m128 vecA0 = _mm_setr_ps(A[j * N + i], A[(j + 1) * N + i], A[(j + 2) * N + i], A[(j + 3) * N + i]);
-            vecA0 = _mm_andnot_ps(_mm_set1_ps(-0.0f), vecA0);
-            vecSum = _mm_add_ps(vecSum, vecA0);
+/*
+ * Обе нормы за один построчный проход: суммы строк копятся в регистре, суммы
+ * столбцов - в собственном массиве каждой полосы строк, которые затем
+ * складываются (N * число полос операций вместо второго прохода по матрице).
+ */
+void findMaxAbsSums(const float* A, const size_t N, float& rowMax, float& colMax) {
+    ThreadPool& pool = threadPool();
+    const size_t tiles = max<size_t>(1, min(pool.size(), N / 16));
+    vector<float> rowSums(N);
+    vector<float> colSums(tiles * N, 0.0f);
+    pool.run(tiles, [&](size_t t) {
+        float* cols = &colSums[t * N];
+        for (size_t i = t * N / tiles; i < (t + 1) * N / tiles; ++i) {
+            __m128 vecSum = _mm_setzero_ps();
+            size_t j = 0;
+            for (; j + 3 < N; j += 4) {
+                __m128 vecA = _mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_loadu_ps(&A[i * N + j]));
+                vecSum = _mm_add_ps(vecSum, vecA);
+                _mm_storeu_ps(&cols[j], _mm_add_ps(_mm_loadu_ps(&cols[j]), vecA));
+            }
+            float sumArr[4];
+            _mm_storeu_ps(sumArr, vecSum);
+            float sum = sumArr[0] + sumArr[1] + sumArr[2] + sumArr[3];
+            for (; j < N; ++j) {
+                sum += fabsf(A[i * N + j]);
+                cols[j] += fabsf(A[i * N + j]);
+            }
+            rowSums[i] = sum;
         }
-        float sumArr[4];
-        _mm_storeu_ps(sumArr, vecSum);
-        float sum = sumArr[0] + sumArr[1] + sumArr[2] + sumArr[3];
-        for (size_t; j < N; ++j) {
-            sum += fabsf(A[j * N + i]);
+    });
+    for (size_t t = 1; t < tiles; ++t) {
+        for (size_t j = 0; j < N; ++j) {
+            colSums[j] += colSums[t * N + j];
         }
-        res = max(sum, res);
     }
-    return res;
+    rowMax = *max_element(rowSums.begin(), rowSums.end());
+    colMax = *max_element(colSums.begin(), colSums.begin() + N);
 }
 
-void initIdentityMatrix(float* Res, const size_t N) {
-    memset(Res, 0, N * N * sizeof(float));
-    __m128 zero = _mm_setzero_ps();
-    __m128 one = _mm_set_ss(1.0f);
-    for (size_t i = 0; i < N; ++i) {
-        for (size_t j = 0; j < N; j += 4) {
-            _mm_storeu_ps(&Res[i * N + j], zero);
+/* B = A^T / k одним проходом, плитками 64 x 64, чтобы и чтение, и запись оставались в L1. */
+void scaledTranspose(const float* A, float* B, const float k, const size_t N) {
+    const size_t tile = 64;
+    __m128 vecK = _mm_set1_ps(k);
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t ii = first; ii < last; ii += tile) {
+            for (size_t jj = 0; jj < N; jj += tile) {
+                for (size_t i = ii; i < min(ii + tile, last); i += 4) {
+                    for (size_t j = jj; j < min(jj + tile, N); j += 4) {
+                        __m128 row0 = _mm_div_ps(_mm_loadu_ps(&A[i * N + j]), vecK);
+                        __m128 row1 = _mm_div_ps(_mm_loadu_ps(&A[(i + 1) * N + j]), vecK);
+                        __m128 row2 = _mm_div_ps(_mm_loadu_ps(&A[(i + 2) * N + j]), vecK);
+                        __m128 row3 = _mm_div_ps(_mm_loadu_ps(&A[(i + 3) * N + j]), vecK);
+                        _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+                        _mm_storeu_ps(&B[j * N + i], row0);
+                        _mm_storeu_ps(&B[(j + 1) * N + i], row1);
+                        _mm_storeu_ps(&B[(j + 2) * N + i], row2);
+                        _mm_storeu_ps(&B[(j + 3) * N + i], row3);
+                    }
+                }
+            }
         }
-        Res[i * N + i] = 1.0f;
-    }
+    }, tile);
+}
+
+/*
+ * Начало обращения: B = A^T / (|A|_1 |A|_inf) и R = I - BA. Нормы считаются
+ * за один проход, B - одной блочной транспозицией, а вычитание из единичной
+ * матрицы выполняет сам GEMM: R заполняется I, и BA добавляется с alpha = -1.
+ */
+void inversionPreamble(const float* A, float* B, float* R, const size_t N) {
+    float rowMax, colMax;
+    findMaxAbsSums(A, N, rowMax, colMax);
+    scaledTranspose(A, B, colMax * rowMax, N);
+    initIdentityMatrix(R, N);
+    gemm(N, N, N, B, N, A, N, R, N, true, -1.0f);
 }
 
+/*
+ * Матрицы matrixConversion в общей рабочей области: B (сначала A^T),
+ * R = I - BA, сумма ряда и два буфера степени R, которые меняются ролями.
+ */
+enum { WS_B, WS_R, WS_SUM, WS_POWER, WS_POWER_NEXT, WS_COUNT };
+
 double matrixConversion(float* A, float* Res, const size_t N, const size_t M) {
-    float* B = new float[N * N];
-    float* AT = new float[N * N];
-    float* R = new float[N * N];
-    float* identityMatrix = new float[N * N];
-    float* tmp = new float[N * N];
-    float* tmp2 = new float[N * N];
-    clock_t inversion_start = clock();
-    transposeMatrix(A, AT, N);
-    divMatrix(AT, B, findMaxAbsSumByColumns(A, N) * findMaxAbsSumByRows(A, N), N);
-    mulMatrix(B, A, tmp, N);
-    initIdentityMatrix(identityMatrix, N);
-    subMatrix(identityMatrix, tmp, R, N);
-    initIdentityMatrix(Res, N);
-    memcpy(tmp, R, N * N * sizeof(float));
+    Workspace& ws = workspace();
+    ws.reserve(WS_COUNT, N);
+    float* B = ws.matrix(WS_B);
+    float* R = ws.matrix(WS_R);
+    float* sum = ws.matrix(WS_SUM);
+    float* tmp = ws.matrix(WS_POWER);
+    float* tmp2 = ws.matrix(WS_POWER_NEXT);
+
+    auto inversion_start = chrono::steady_clock::now();
+    inversionPreamble(A, B, R, N);
+    initIdentityMatrix(sum, N);
 
+    float* power = R;
     for (size_t i = 1; i < M; ++i) {
-        addMatrix(Res, tmp, Res, N);
+        addMatrix(sum, power, sum, N);
         if (i < M - 1) {
-            mulMatrix(tmp, R, tmp2, N);
-            memcpy(tmp, tmp2, N * N * sizeof(float));
+            mulMatrix(power, R, tmp, N);
+            power = tmp;
+            swap(tmp, tmp2);
         }
     }
-    mulMatrix(Res, B, tmp, N);
-    memcpy(Res, tmp, N * N * sizeof(float));
-    clock_t inversion_end = clock();
+    mulMatrix(sum, B, Res, N);
+    auto inversion_end = chrono::steady_clock::now();
 
-    delete[] B;
-    delete[] AT;
-    delete[] R;
-    delete[] identityMatrix;
-    delete[] tmp;
-    delete[] tmp2;
-    return static_cast<double>(inversion_end - inversion_start) / CLOCKS_PER_SEC;
+    return chrono::duration<double>(inversion_end - inversion_start).count();
+}
+
+enum Precision { PRECISION_FP32, PRECISION_BF16, PRECISION_FP16 };
+
+const char* precisionNames[] = {"fp32", "bf16", "fp16"};
+
+struct SeriesOptions {
+    size_t maxTerms;
+    float tolerance;
+    bool squaring;
+    Precision precision;
+};
+
+struct SeriesResult {
+    size_t terms;
+    size_t gemms;
+    float residual;
+    double time;
+};
+
+/*
+ * Хранение сомножителя GEMM в типе T: для float возвращает саму матрицу,
+ * иначе переводит её в buf с округлением.
+ */
+template <class T>
+const T* storeMatrix(const float* A, float* buf, const size_t N) {
+    if (is_same<T, float>::value) {
+        return reinterpret_cast<const T*>(A);
+    }
+    T* out = reinterpret_cast<T*>(buf);
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first * N; i < last * N; ++i) {
+            out[i] = gemmFromFloat<T>(A[i]);
+        }
+    });
+    return out;
+}
+
+enum {
+    SERIES_B, SERIES_R, SERIES_SUM, SERIES_SUM_NEXT, SERIES_POWER, SERIES_POWER_NEXT,
+    SERIES_R_STORED, SERIES_POWER_STORED, SERIES_COUNT
+};
+
+/*
+ * Тот же ряд, что и в matrixConversion, но с контролем сходимости. Для суммы
+ * S_k = I + R + ... + R^(k-1) выполняется S_k B A = I - R^k, поэтому невязка
+ * |I - Res A| равна норме уже вычисленной степени R^k и стоит один проход
+ * по матрице. Ряд останавливается, когда она меньше tolerance, или по
+ * достижении maxTerms членов. При squaring сумма удваивается за шаг:
+ * S_2k = S_k (I + R^k), R^2k = R^k R^k, то есть 2 GEMM на удвоение вместо k.
+ * Степени R хранятся в типе T (float, bf16, fp16), сумма и накопление - в fp32.
+ */
+template <class T>
+SeriesResult seriesInversion(const float* A, float* Res, const size_t N, const SeriesOptions& options) {
+    Workspace& ws = workspace();
+    ws.reserve(SERIES_COUNT, N);
+    float* B = ws.matrix(SERIES_B);
+    float* R = ws.matrix(SERIES_R);
+    float* sum = ws.matrix(SERIES_SUM);
+    float* sumNext = ws.matrix(SERIES_SUM_NEXT);
+    float* powerBuffers[2] = {ws.matrix(SERIES_POWER), ws.matrix(SERIES_POWER_NEXT)};
+    SeriesResult result = {1, 0, 0, 0};
+
+    auto start = chrono::steady_clock::now();
+    inversionPreamble(A, B, R, N);
+    initIdentityMatrix(sum, N);
+
+    const T* storedR = storeMatrix<T>(R, ws.matrix(SERIES_R_STORED), N);
+    float* power = R;
+    const T* storedPower = storedR;
+    result.residual = findMaxAbsSumByRows(power, N);
+    while (result.residual > options.tolerance) {
+        float* next = power == powerBuffers[0] ? powerBuffers[1] : powerBuffers[0];
+        if (options.squaring) {
+            if (result.terms * 2 > options.maxTerms) {
+                break;
+            }
+            if (result.terms == 1) {
+                addMatrix(sum, power, sum, N);
+            } else {
+                gemm(N, N, N, sum, N, storedPower, N, sumNext, N);
+                addMatrix(sumNext, sum, sumNext, N);
+                swap(sum, sumNext);
+                ++result.gemms;
+            }
+            result.terms *= 2;
+            gemm(N, N, N, storedPower, N, storedPower, N, next, N);
+        } else {
+            if (result.terms + 1 > options.maxTerms) {
+                break;
+            }
+            addMatrix(sum, power, sum, N);
+            result.terms += 1;
+            gemm(N, N, N, storedPower, N, storedR, N, next, N);
+        }
+        ++result.gemms;
+        power = next;
+        storedPower = storeMatrix<T>(power, ws.matrix(SERIES_POWER_STORED), N);
+        result.residual = findMaxAbsSumByRows(power, N);
+    }
+    mulMatrix(sum, B, Res, N);
+    ++result.gemms;
+    result.time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+SeriesResult matrixConversionAdaptive(const float* A, float* Res, const size_t N, const SeriesOptions& options) {
+    switch (options.precision) {
+        case PRECISION_BF16: return seriesInversion<GemmBf16>(A, Res, N, options);
+        case PRECISION_FP16: return seriesInversion<GemmFp16>(A, Res, N, options);
+        default: return seriesInversion<float>(A, Res, N, options);
+    }
+}
+
+/* Фактическая невязка |I - Res A| по строкам; считается вне замеров. */
+float inverseResidual(const float* A, const float* Res, const size_t N) {
+    float* prod = new float[N * N];
+    float* identity = new float[N * N];
+    mulMatrix(Res, A, prod, N);
+    initIdentityMatrix(identity, N);
+    subMatrix(identity, prod, prod, N);
+    float residual = findMaxAbsSumByRows(prod, N);
+    delete[] prod;
+    delete[] identity;
+    return residual;
 }
 
 void fillRandomMatrix(float* A, const size_t N) {
@@ -183,14 +312,406 @@ void printMatrix(const float* A, const size_t N){
     }
 }
 
-int main(void) {
+double now() {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+float maxAbsDiff(const float* A, const float* B, const size_t N) {
+    float res = 0;
+    for (size_t i = 0; i < N * N; ++i) {
+        res = max(res, fabsf(A[i] - B[i]));
+    }
+    return res;
+}
+
+void gemmBenchmark() {
+    const size_t sizes[] = {256, 512, 1024, 2048};
+    cout << "N\tblocked SSE";
+    for (int isa = 0; isa < GEMM_ISA_COUNT; ++isa) {
+        if (gemmIsaSupported(static_cast<GemmIsa>(isa))) {
+            cout << "\t" << gemmIsaName(static_cast<GemmIsa>(isa));
+        }
+    }
+#ifdef WITH_CBLAS
+    cout << "\tcblas_sgemm";
+#endif
+    cout << "\t(GFLOP/s)" << endl;
+    GemmIsa active = gemmActiveIsa();
+    for (size_t N : sizes) {
+        float* A = new float[N * N];
+        float* B = new float[N * N];
+        float* ref = new float[N * N];
+        float* C = new float[N * N];
+        fillRandomMatrix(A, N);
+        fillRandomMatrix(B, N);
+        double flops = 2.0 * N * N * N;
+
+        double start = now();
+        mulMatrixBlocked(A, B, ref, N);
+        cout << N << "\t" << flops / (now() - start) * 1e-9;
+        for (int isa = 0; isa < GEMM_ISA_COUNT; ++isa) {
+            if (!gemmIsaSupported(static_cast<GemmIsa>(isa))) {
+                continue;
+            }
+            gemmSetIsa(static_cast<GemmIsa>(isa));
+            start = now();
+            mulMatrix(A, B, C, N);
+            cout << "\t" << flops / (now() - start) * 1e-9;
+            if (maxAbsDiff(ref, C, N) > 1e-3f * N) {
+                cerr << gemmIsaName(static_cast<GemmIsa>(isa)) << ": результат расходится с blocked SSE" << endl;
+            }
+        }
+#ifdef WITH_CBLAS
+        start = now();
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, N, N, N, 1.0f, A, N, B, N, 0.0f, C, N);
+        cout << "\t" << flops / (now() - start) * 1e-9;
+#endif
+        cout << endl;
+        delete[] A;
+        delete[] B;
+        delete[] ref;
+        delete[] C;
+    }
+    gemmSetIsa(active);
+}
+
+/*
+ * Ошибка C относительно произведения в double по выборке элементов:
+ * max |C - AB|_ij / (|A||B|)_ij, то есть в единицах округления скалярного
+ * произведения, а не самого результата.
+ */
+double sampledProductError(const float* A, const float* B, const float* C, const size_t N) {
+    mt19937 gen(1);
+    uniform_int_distribution<size_t> index(0, N - 1);
+    double err = 0;
+    for (int s = 0; s < 256; ++s) {
+        size_t i = index(gen), j = index(gen);
+        double exact = 0, scale = 0;
+        for (size_t k = 0; k < N; ++k) {
+            exact += static_cast<double>(A[i * N + k]) * B[k * N + j];
+            scale += fabs(static_cast<double>(A[i * N + k]) * B[k * N + j]);
+        }
+        err = max(err, fabs(C[i * N + j] - exact) / scale);
+    }
+    return err;
+}
+
+/*
+ * Штрассен-Виноград с разными порогами против SSE-GEMM, GEMM активного
+ * набора инструкций и cblas_sgemm: эффективные GFLOP/s (2N^3 / время) и
+ * относительная ошибка по выборке элементов.
+ */
+void strassenBenchmark() {
+    const size_t sizes[] = {256, 512, 1024, 2048, 4096};
+    const size_t cutoffs[] = {128, 256, 512, 1024};
+    vector<string> names = {"gemm sse", string("gemm ") + gemmIsaName(gemmActiveIsa())};
+    for (size_t cutoff : cutoffs) {
+        names.push_back("strassen/" + to_string(cutoff));
+    }
+#ifdef WITH_CBLAS
+    names.push_back("cblas_sgemm");
+#endif
+    vector<vector<double>> gflops, errors;
+    for (size_t N : sizes) {
+        float* A = new float[N * N];
+        float* B = new float[N * N];
+        float* C = new float[N * N];
+        fillRandomMatrix(A, N);
+        fillRandomMatrix(B, N);
+        const double flops = 2.0 * N * N * N;
+        vector<double> speed, error;
+        auto run = [&](auto multiply) {
+            multiply();
+            double start = now();
+            multiply();
+            speed.push_back(flops / (now() - start) * 1e-9);
+            error.push_back(sampledProductError(A, B, C, N));
+        };
+        run([&] { sse::mulMatrix(A, B, C, N); });
+        run([&] { gemm(N, N, N, A, N, B, N, C, N); });
+        for (size_t cutoff : cutoffs) {
+            run([&] { strassenMul(A, B, C, N, cutoff); });
+        }
+#ifdef WITH_CBLAS
+        run([&] { cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, N, N, N, 1.0f, A, N, B, N, 0.0f, C, N); });
+#endif
+        gflops.push_back(speed);
+        errors.push_back(error);
+        delete[] A;
+        delete[] B;
+        delete[] C;
+    }
+    for (int table = 0; table < 2; ++table) {
+        cout << (table == 0 ? "GFLOP/s" : "Относительная ошибка") << endl << "N";
+        for (const string& name : names) {
+            cout << "\t" << name;
+        }
+        cout << endl;
+        for (size_t n = 0; n < gflops.size(); ++n) {
+            cout << sizes[n];
+            for (size_t b = 0; b < names.size(); ++b) {
+                cout << "\t" << (table == 0 ? gflops[n][b] : errors[n][b]);
+            }
+            cout << endl;
+        }
+        cout << endl;
+    }
+}
+
+/*
+ * Пакет маленьких матриц: batchedInverse против цикла matrixConversion по
+ * каждой матрице. Перестановка в чередующийся вид считается отдельно.
+ */
+void batchBenchmark() {
+    const size_t sizes[] = {8, 16, 32, 64, 128};
+    const size_t M = 10;
+    cout << "N\tМатриц\tЦикл, матриц/с\tПакет, матриц/с\tУскорение\tПерестановка, с\tРасхождение" << endl;
+    for (size_t N : sizes) {
+        const size_t count = max<size_t>(64, (1 << 20) / (N * N));
+        float* A = new float[count * N * N];
+        float* ref = new float[count * N * N];
+        float* res = new float[count * N * N];
+        float* batchA = static_cast<float*>(aligned_alloc(64, batchStorage(count, N) * sizeof(float)));
+        float* batchX = static_cast<float*>(aligned_alloc(64, batchStorage(count, N) * sizeof(float)));
+        for (size_t m = 0; m < count; ++m) {
+            fillRandomMatrix(&A[m * N * N], N);
+        }
+
+        double start = now();
+        for (size_t m = 0; m < count; ++m) {
+            matrixConversion(&A[m * N * N], &ref[m * N * N], N, M);
+        }
+        double loopTime = now() - start;
+
+        start = now();
+        batchInterleave(A, batchA, count, N);
+        double interleaveTime = now() - start;
+        start = now();
+        batchedInverse(batchA, batchX, count, N, M);
+        double batchTime = now() - start;
+        start = now();
+        batchDeinterleave(batchX, res, count, N);
+        interleaveTime += now() - start;
+
+        float diff = 0;
+        for (size_t m = 0; m < count; ++m) {
+            diff = max(diff, maxAbsDiff(&ref[m * N * N], &res[m * N * N], N));
+        }
+        cout << N << "\t" << count << "\t" << count / loopTime << "\t" << count / batchTime << "\t"
+             << loopTime / batchTime << "\t" << interleaveTime << "\t" << diff << endl;
+        delete[] A;
+        delete[] ref;
+        delete[] res;
+        free(batchA);
+        free(batchX);
+    }
+}
+
+/*
+ * Обычный ряд и удвоение во всех точностях хранения с одной и той же
+ * границей невязки. wellConditioned усиливает диагональ, чтобы ряд сходился
+ * за разумное число членов.
+ */
+void seriesBenchmark(const size_t N, SeriesOptions options, bool wellConditioned) {
+    float* A = new float[N * N];
+    float* A_inv = new float[N * N];
+    fillRandomMatrix(A, N);
+    if (wellConditioned) {
+        for (size_t i = 0; i < N; ++i) {
+            A[i * N + i] += 10.0f * N;
+        }
+    }
+    cout << "Допуск " << options.tolerance << ", не больше " << options.maxTerms << " членов" << endl;
+    cout << "Режим\tХранение\tЧленов\tGEMM\t|R^k|\t|I - Res A|\tВремя, с" << endl;
+    for (int squaring = 0; squaring < 2; ++squaring) {
+        for (int precision = PRECISION_FP32; precision <= PRECISION_FP16; ++precision) {
+            options.squaring = squaring;
+            options.precision = static_cast<Precision>(precision);
+            SeriesResult result = matrixConversionAdaptive(A, A_inv, N, options);
+            cout << (squaring ? "удвоение" : "ряд") << "\t" << precisionNames[precision] << "\t"
+                 << result.terms << "\t" << result.gemms << "\t" << result.residual << "\t"
+                 << inverseResidual(A, A_inv, N) << "\t" << result.time << endl;
+        }
+    }
+    delete[] A;
+    delete[] A_inv;
+}
+
+/*
+ * Начало обращения по отдельным проходам (как было) и слитно. Объём
+ * памяти считается по проходам над матрицами N x N без учёта трафика
+ * внутри GEMM, одинакового в обоих вариантах.
+ */
+void preambleBenchmark(const size_t N) {
+    const double matrix = N * N * sizeof(float);
+    float* A = new float[N * N];
+    float* AT = new float[N * N];
+    float* B = new float[N * N];
+    float* identity = new float[N * N];
+    float* tmp = new float[N * N];
+    float* R = new float[N * N];
+    float* fusedB = new float[N * N];
+    float* fusedR = new float[N * N];
+    fillRandomMatrix(A, N);
+
+    struct Stage {
+        const char* name;
+        double bytes;
+        double time;
+    };
+    vector<Stage> before, after;
+    auto stage = [&](vector<Stage>& stages, const char* name, double bytes, auto body) {
+        double start = now();
+        body();
+        stages.push_back({name, bytes, now() - start});
+    };
+
+    float colMax = 0, rowMax = 0;
+    stage(before, "transposeMatrix", 2 * matrix, [&] { transposeMatrix(A, AT, N); });
+    stage(before, "findMaxAbsSumByColumns", matrix, [&] { colMax = findMaxAbsSumByColumns(A, N); });
+    stage(before, "findMaxAbsSumByRows", matrix, [&] { rowMax = findMaxAbsSumByRows(A, N); });
+    stage(before, "divMatrix", 2 * matrix, [&] { divMatrix(AT, B, colMax * rowMax, N); });
+    stage(before, "mulMatrix (с обнулением)", matrix, [&] { mulMatrix(B, A, tmp, N); });
+    stage(before, "initIdentityMatrix", matrix, [&] { initIdentityMatrix(identity, N); });
+    stage(before, "subMatrix", 3 * matrix, [&] { subMatrix(identity, tmp, R, N); });
+
+    stage(after, "findMaxAbsSums", matrix, [&] { findMaxAbsSums(A, N, rowMax, colMax); });
+    stage(after, "scaledTranspose", 2 * matrix, [&] { scaledTranspose(A, fusedB, colMax * rowMax, N); });
+    stage(after, "initIdentityMatrix", matrix, [&] { initIdentityMatrix(fusedR, N); });
+    stage(after, "gemm(alpha = -1, C = I)", 0, [&] { gemm(N, N, N, fusedB, N, A, N, fusedR, N, true, -1.0f); });
+
+    for (vector<Stage>* stages : {&before, &after}) {
+        cout << (stages == &before ? "Раздельно" : "Слитно") << ":" << endl;
+        double bytes = 0, time = 0, gemmTime = 0;
+        for (const Stage& s : *stages) {
+            cout << "  " << s.name << "\t" << s.bytes / (1 << 20) << " МБ\t" << s.time << " с" << endl;
+            bytes += s.bytes;
+            time += s.time;
+            if (strncmp(s.name, "mulMatrix", 9) == 0 || strncmp(s.name, "gemm", 4) == 0) {
+                gemmTime += s.time;
+            }
+        }
+        cout << "  Итого: " << bytes / (1 << 20) << " МБ, " << time << " с, без GEMM " << time - gemmTime << " с" << endl;
+    }
+    cout << "Расхождение B: " << maxAbsDiff(B, fusedB, N) << ", R: " << maxAbsDiff(R, fusedR, N) << endl;
+    delete[] A;
+    delete[] AT;
+    delete[] B;
+    delete[] identity;
+    delete[] tmp;
+    delete[] R;
+    delete[] fusedB;
+    delete[] fusedR;
+}
+
+size_t nextThreadCount(size_t threads, size_t maxThreads) {
+    return threads * 2 <= maxThreads || threads == maxThreads ? threads * 2 : maxThreads;
+}
+
+/* Сильная масштабируемость: одно и то же обращение N x N на 1, 2, 4, ... maxThreads потоках. */
+void scalingBenchmark(const size_t N, const size_t M, size_t maxThreads) {
+    float* A = new float[N * N];
+    float* A_inv = new float[N * N];
+    fillRandomMatrix(A, N);
+    cout << "Потоки\tВремя, с\tУскорение\tЭффективность" << endl;
+    double single = 0;
+    for (size_t threads = 1; threads <= maxThreads; threads = nextThreadCount(threads, maxThreads)) {
+        threadPool().resize(threads);
+        double time = matrixConversion(A, A_inv, N, M);
+        if (threads == 1) {
+            single = time;
+        }
+        cout << threads << "\t" << time << "\t" << single / time << "\t" << single / time / threads << endl;
+    }
+    delete[] A;
+    delete[] A_inv;
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxThreads = threadPool().size();
+    bool scaling = false;
+    int repeat = 1;
+    bool gemmBench = false;
+    bool batchBench = false;
+    bool seriesBench = false;
+    bool preambleBench = false;
+    bool strassenBench = false;
+    bool wellConditioned = false;
+    SeriesOptions series = {64, 1e-4f, false, PRECISION_FP32};
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--gemm-bench") == 0) {
+            gemmBench = true;
+        } else if (strcmp(argv[i], "--batch-bench") == 0) {
+            batchBench = true;
+        } else if (strcmp(argv[i], "--series-bench") == 0) {
+            seriesBench = true;
+        } else if (strcmp(argv[i], "--preamble-bench") == 0) {
+            preambleBench = true;
+        } else if (strcmp(argv[i], "--strassen-bench") == 0) {
+            strassenBench = true;
+        } else if (strcmp(argv[i], "--strassen") == 0 && i + 1 < argc) {
+            useStrassen = true;
+            strassenCutoff() = max(atoi(argv[++i]), 16);
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            series.tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-terms") == 0 && i + 1 < argc) {
+            series.maxTerms = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--well-conditioned") == 0) {
+            wellConditioned = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            maxThreads = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        } else if (strcmp(argv[i], "--huge-pages") == 0) {
+            workspace().setHugePages(true);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = max(atoi(argv[++i]), 1);
+        }
+    }
+    if (gemmBench) {
+        threadPool().resize(maxThreads);
+        gemmBenchmark();
+        return 0;
+    }
+    if (strassenBench) {
+        threadPool().resize(maxThreads);
+        strassenBenchmark();
+        return 0;
+    }
+    if (batchBench) {
+        threadPool().resize(maxThreads);
+        batchBenchmark();
+        return 0;
+    }
     const size_t N = 2048;
     const size_t M = 10;
+    if (scaling) {
+        scalingBenchmark(N, M, maxThreads);
+        return 0;
+    }
+    if (preambleBench) {
+        threadPool().resize(maxThreads);
+        preambleBenchmark(N);
+        return 0;
+    }
+    if (seriesBench) {
+        threadPool().resize(maxThreads);
+        seriesBenchmark(N, series, wellConditioned);
+        return 0;
+    }
+    threadPool().resize(maxThreads);
     float* A = new float[N * N];
     float* A_inv = new float[N * N];
     fillRandomMatrix(A, N);
-    double inversion_time = matrixConversion(A, A_inv, N, M);
-    cout << "Время обращения: " << inversion_time << " sec " << endl;
+    auto prepare_start = chrono::steady_clock::now();
+    workspace().reserve(WS_COUNT, N);
+    double prepare_time = chrono::duration<double>(chrono::steady_clock::now() - prepare_start).count();
+    cout << "Рабочая область: " << workspace().bytes() / (1024 * 1024) << " МБ (" << workspace().backing()
+         << "), выделение и заполнение страниц: " << prepare_time << " sec (вынесено из замера)" << endl;
+    for (int r = 0; r < repeat; ++r) {
+        double inversion_time = matrixConversion(A, A_inv, N, M);
+        cout << "Время обращения: " << inversion_time << " sec " << endl;
+    }
     delete[] A;
     delete[] A_inv;
     cout << "Программа завершена." << endl;
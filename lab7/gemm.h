@@ -0,0 +1,393 @@
+#ifndef LAB7_GEMM_H
+#define LAB7_GEMM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <immintrin.h>
+#include "thread_pool.h"
+
+/*
+ * Умножение матриц в духе GotoBLAS: B упаковывается панелями KC x NR (L1),
+ * A - блоками MC x KC (L2), а микроядро держит в регистрах плитку MR x NR
+ * результата и проходит по k без обращений к C. Ядро выбирается при запуске
+ * по возможностям процессора: SSE (6x8), AVX2+FMA (6x16) или AVX-512 (6x32).
+ * Блоки MC строк A раздаются потокам общего пула, у каждого потока свой
+ * буфер упакованного A, панель B общая.
+ *
+ * Входные матрицы могут храниться в bf16 или fp16: элементы переводятся во
+ * float при упаковке, так что микроядра и накопление остаются в fp32.
+ */
+
+enum GemmIsa { GEMM_SSE, GEMM_AVX2, GEMM_AVX512, GEMM_ISA_COUNT };
+
+const size_t GEMM_MR = 6;
+const size_t GEMM_KC = 256;
+const size_t GEMM_MC = 96;
+const size_t GEMM_NC = 2048;
+
+inline const char* gemmIsaName(GemmIsa isa) {
+    switch (isa) {
+        case GEMM_AVX512: return "avx512";
+        case GEMM_AVX2: return "avx2";
+        default: return "sse";
+    }
+}
+
+inline size_t gemmNR(GemmIsa isa) {
+    switch (isa) {
+        case GEMM_AVX512: return 32;
+        case GEMM_AVX2: return 16;
+        default: return 8;
+    }
+}
+
+inline bool gemmIsaSupported(GemmIsa isa) {
+    __builtin_cpu_init();
+    switch (isa) {
+        case GEMM_AVX512: return __builtin_cpu_supports("avx512f");
+        case GEMM_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        default: return true;
+    }
+}
+
+inline GemmIsa& gemmActiveIsa() {
+    static GemmIsa isa = gemmIsaSupported(GEMM_AVX512) ? GEMM_AVX512
+                       : gemmIsaSupported(GEMM_AVX2) ? GEMM_AVX2 : GEMM_SSE;
+    return isa;
+}
+
+inline void gemmSetIsa(GemmIsa isa) {
+    if (gemmIsaSupported(isa)) {
+        gemmActiveIsa() = isa;
+    }
+}
+
+struct GemmBf16 {
+    uint16_t bits;
+};
+
+struct GemmFp16 {
+    uint16_t bits;
+};
+
+inline float gemmBitsToFloat(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline uint32_t gemmFloatToBits(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+inline float gemmToFloat(float x) {
+    return x;
+}
+
+inline float gemmToFloat(GemmBf16 x) {
+    return gemmBitsToFloat(static_cast<uint32_t>(x.bits) << 16);
+}
+
+inline float gemmToFloat(GemmFp16 x) {
+    uint32_t sign = static_cast<uint32_t>(x.bits & 0x8000) << 16;
+    uint32_t exp = (x.bits >> 10) & 0x1f;
+    uint32_t mant = x.bits & 0x3ff;
+    if (exp == 0) {
+        float f = mant * 5.9604645e-8f;
+        return sign ? -f : f;
+    }
+    if (exp == 31) {
+        return gemmBitsToFloat(sign | 0x7f800000 | (mant << 13));
+    }
+    return gemmBitsToFloat(sign | ((exp + 112) << 23) | (mant << 13));
+}
+
+/* Перевод из float с округлением к ближайшему чётному. */
+template <class T>
+inline T gemmFromFloat(float f);
+
+template <>
+inline float gemmFromFloat<float>(float f) {
+    return f;
+}
+
+template <>
+inline GemmBf16 gemmFromFloat<GemmBf16>(float f) {
+    uint32_t x = gemmFloatToBits(f);
+    if ((x & 0x7fffffff) > 0x7f800000) {
+        return GemmBf16{static_cast<uint16_t>((x >> 16) | 0x40)};
+    }
+    return GemmBf16{static_cast<uint16_t>((x + 0x7fff + ((x >> 16) & 1)) >> 16)};
+}
+
+template <>
+inline GemmFp16 gemmFromFloat<GemmFp16>(float f) {
+    uint32_t x = gemmFloatToBits(f);
+    uint16_t sign = (x >> 16) & 0x8000;
+    x &= 0x7fffffff;
+    if (x > 0x7f800000) {
+        return GemmFp16{static_cast<uint16_t>(sign | 0x7e00)};
+    }
+    if (x >= 0x477ff000) {
+        return GemmFp16{static_cast<uint16_t>(sign | 0x7c00)};
+    }
+    if (x < 0x38800000) {
+        return GemmFp16{static_cast<uint16_t>(sign | lrintf(gemmBitsToFloat(x) * 16777216.0f))};
+    }
+    x += 0xfff + ((x >> 13) & 1);
+    return GemmFp16{static_cast<uint16_t>(sign | ((x - 0x38000000) >> 13))};
+}
+
+struct GemmBuffer {
+    float* data = nullptr;
+    size_t size = 0;
+
+    float* get(size_t n) {
+        if (n > size) {
+            free(data);
+            size = n;
+            data = static_cast<float*>(aligned_alloc(64, (n * sizeof(float) + 63) / 64 * 64));
+        }
+        return data;
+    }
+
+    ~GemmBuffer() {
+        free(data);
+    }
+};
+
+/*
+ * Панели по MR строк: для каждого k подряд лежат MR элементов столбца, хвост
+ * дополняется нулями. Множитель alpha применяется здесь же, бесплатно.
+ */
+template <class T>
+inline void gemmPackA(const T* A, size_t lda, size_t mc, size_t kc, float alpha, float* buf) {
+    for (size_t i = 0; i < mc; i += GEMM_MR) {
+        size_t rows = std::min(GEMM_MR, mc - i);
+        for (size_t k = 0; k < kc; ++k) {
+            for (size_t r = 0; r < rows; ++r) {
+                buf[r] = alpha * gemmToFloat(A[(i + r) * lda + k]);
+            }
+            for (size_t r = rows; r < GEMM_MR; ++r) {
+                buf[r] = 0.0f;
+            }
+            buf += GEMM_MR;
+        }
+    }
+}
+
+/* Панели по NR столбцов: для каждого k подряд лежат NR элементов строки. */
+template <class T>
+inline void gemmPackB(const T* B, size_t ldb, size_t kc, size_t nc, size_t nr, float* buf) {
+    for (size_t j = 0; j < nc; j += nr) {
+        size_t cols = std::min(nr, nc - j);
+        for (size_t k = 0; k < kc; ++k) {
+            if (std::is_same<T, float>::value) {
+                memcpy(buf, &B[k * ldb + j], cols * sizeof(float));
+            } else {
+                for (size_t c = 0; c < cols; ++c) {
+                    buf[c] = gemmToFloat(B[k * ldb + j + c]);
+                }
+            }
+            for (size_t c = cols; c < nr; ++c) {
+                buf[c] = 0.0f;
+            }
+            buf += nr;
+        }
+    }
+}
+
+/* Добавляет плитку tile (MR x nrFull) к C, ограничиваясь mr x nr. */
+inline void gemmAddTile(const float* tile, size_t nrFull, float* C, size_t ldc, size_t mr, size_t nr) {
+    for (size_t r = 0; r < mr; ++r) {
+        for (size_t c = 0; c < nr; ++c) {
+            C[r * ldc + c] += tile[r * nrFull + c];
+        }
+    }
+}
+
+inline void gemmKernelSse(size_t kc, const float* a, const float* b, float* C, size_t ldc, size_t mr, size_t nr) {
+    __m128 acc[GEMM_MR][2];
+#pragma GCC unroll 6
+    for (size_t r = 0; r < GEMM_MR; ++r) {
+        acc[r][0] = _mm_setzero_ps();
+        acc[r][1] = _mm_setzero_ps();
+    }
+    for (size_t k = 0; k < kc; ++k) {
+        __m128 b0 = _mm_load_ps(b);
+        __m128 b1 = _mm_load_ps(b + 4);
+#pragma GCC unroll 6
+        for (size_t r = 0; r < GEMM_MR; ++r) {
+            __m128 ar = _mm_set1_ps(a[r]);
+            acc[r][0] = _mm_add_ps(acc[r][0], _mm_mul_ps(ar, b0));
+            acc[r][1] = _mm_add_ps(acc[r][1], _mm_mul_ps(ar, b1));
+        }
+        a += GEMM_MR;
+        b += 8;
+    }
+    if (mr == GEMM_MR && nr == 8) {
+#pragma GCC unroll 6
+        for (size_t r = 0; r < GEMM_MR; ++r) {
+            float* c = &C[r * ldc];
+            _mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), acc[r][0]));
+            _mm_storeu_ps(c + 4, _mm_add_ps(_mm_loadu_ps(c + 4), acc[r][1]));
+        }
+        return;
+    }
+    alignas(64) float tile[GEMM_MR * 8];
+    for (size_t r = 0; r < GEMM_MR; ++r) {
+        _mm_store_ps(&tile[r * 8], acc[r][0]);
+        _mm_store_ps(&tile[r * 8 + 4], acc[r][1]);
+    }
+    gemmAddTile(tile, 8, C, ldc, mr, nr);
+}
+
+__attribute__((target("avx2,fma")))
+inline void gemmKernelAvx2(size_t kc, const float* a, const float* b, float* C, size_t ldc, size_t mr, size_t nr) {
+    __m256 acc[GEMM_MR][2];
+#pragma GCC unroll 6
+    for (size_t r = 0; r < GEMM_MR; ++r) {
+        acc[r][0] = _mm256_setzero_ps();
+        acc[r][1] = _mm256_setzero_ps();
+    }
+    for (size_t k = 0; k < kc; ++k) {
+        __m256 b0 = _mm256_load_ps(b);
+        __m256 b1 = _mm256_load_ps(b + 8);
+#pragma GCC unroll 6
+        for (size_t r = 0; r < GEMM_MR; ++r) {
+            __m256 ar = _mm256_broadcast_ss(&a[r]);
+            acc[r][0] = _mm256_fmadd_ps(ar, b0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_ps(ar, b1, acc[r][1]);
+        }
+        a += GEMM_MR;
+        b += 16;
+    }
+    if (mr == GEMM_MR && nr == 16) {
+#pragma GCC unroll 6
+        for (size_t r = 0; r < GEMM_MR; ++r) {
+            float* c = &C[r * ldc];
+            _mm256_storeu_ps(c, _mm256_add_ps(_mm256_loadu_ps(c), acc[r][0]));
+            _mm256_storeu_ps(c + 8, _mm256_add_ps(_mm256_loadu_ps(c + 8), acc[r][1]));
+        }
+        return;
+    }
+    alignas(64) float tile[GEMM_MR * 16];
+    for (size_t r = 0; r < GEMM_MR; ++r) {
+        _mm256_store_ps(&tile[r * 16], acc[r][0]);
+        _mm256_store_ps(&tile[r * 16 + 8], acc[r][1]);
+    }
+    gemmAddTile(tile, 16, C, ldc, mr, nr);
+}
+
+__attribute__((target("avx512f")))
+inline void gemmKernelAvx512(size_t kc, const float* a, const float* b, float* C, size_t ldc, size_t mr, size_t nr) {
+    __m512 acc[GEMM_MR][2];
+#pragma GCC unroll 6
+    for (size_t r = 0; r < GEMM_MR; ++r) {
+        acc[r][0] = _mm512_setzero_ps();
+        acc[r][1] = _mm512_setzero_ps();
+    }
+    for (size_t k = 0; k < kc; ++k) {
+        __m512 b0 = _mm512_load_ps(b);
+        __m512 b1 = _mm512_load_ps(b + 16);
+#pragma GCC unroll 6
+        for (size_t r = 0; r < GEMM_MR; ++r) {
+            __m512 ar = _mm512_set1_ps(a[r]);
+            acc[r][0] = _mm512_fmadd_ps(ar, b0, acc[r][0]);
+            acc[r][1] = _mm512_fmadd_ps(ar, b1, acc[r][1]);
+        }
+        a += GEMM_MR;
+        b += 32;
+    }
+    if (mr == GEMM_MR && nr == 32) {
+#pragma GCC unroll 6
+        for (size_t r = 0; r < GEMM_MR; ++r) {
+            float* c = &C[r * ldc];
+            _mm512_storeu_ps(c, _mm512_add_ps(_mm512_loadu_ps(c), acc[r][0]));
+            _mm512_storeu_ps(c + 16, _mm512_add_ps(_mm512_loadu_ps(c + 16), acc[r][1]));
+        }
+        return;
+    }
+    alignas(64) float tile[GEMM_MR * 32];
+    for (size_t r = 0; r < GEMM_MR; ++r) {
+        _mm512_store_ps(&tile[r * 32], acc[r][0]);
+        _mm512_store_ps(&tile[r * 32 + 16], acc[r][1]);
+    }
+    gemmAddTile(tile, 32, C, ldc, mr, nr);
+}
+
+typedef void (*GemmKernel)(size_t, const float*, const float*, float*, size_t, size_t, size_t);
+
+inline GemmKernel gemmKernel(GemmIsa isa) {
+    switch (isa) {
+        case GEMM_AVX512: return gemmKernelAvx512;
+        case GEMM_AVX2: return gemmKernelAvx2;
+        default: return gemmKernelSse;
+    }
+}
+
+/* Макроцикл по блоку ic..ic+mc строк A для уже упакованной панели B. */
+template <class T>
+inline void gemmBlock(GemmIsa isa, size_t mc, size_t nc, size_t kc, const T* A, size_t lda, float alpha,
+                      const float* packedB, float* C, size_t ldc, float* packedA) {
+    const size_t nr = gemmNR(isa);
+    GemmKernel kernel = gemmKernel(isa);
+    gemmPackA(A, lda, mc, kc, alpha, packedA);
+    for (size_t jr = 0; jr < nc; jr += nr) {
+        for (size_t ir = 0; ir < mc; ir += GEMM_MR) {
+            kernel(kc, packedA + ir * kc, packedB + jr * kc, &C[ir * ldc + jr], ldc,
+                   std::min(GEMM_MR, mc - ir), std::min(nr, nc - jr));
+        }
+    }
+}
+
+/*
+ * C (M x N) = alpha * A (M x K) * B (K x N), все матрицы построчные с
+ * ведущими размерностями lda, ldb, ldc. При accumulate результат добавляется
+ * к C, так что, например, R = I - BA получается из C = I при alpha = -1.
+ * A и B могут быть float, GemmBf16 или GemmFp16, C всегда float.
+ */
+template <class TA, class TB>
+inline void gemmWithIsa(GemmIsa isa, size_t M, size_t N, size_t K, const TA* A, size_t lda, const TB* B,
+                        size_t ldb, float* C, size_t ldc, bool accumulate = false, float alpha = 1.0f) {
+    const size_t nr = gemmNR(isa);
+    static thread_local GemmBuffer bufB;
+    float* packedB = bufB.get(GEMM_KC * ((GEMM_NC + nr - 1) / nr * nr));
+    if (!accumulate) {
+        parallelRows(M, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                memset(&C[i * ldc], 0, N * sizeof(float));
+            }
+        });
+    }
+    const size_t blocks = (M + GEMM_MC - 1) / GEMM_MC;
+    for (size_t jc = 0; jc < N; jc += GEMM_NC) {
+        size_t nc = std::min(GEMM_NC, N - jc);
+        for (size_t pc = 0; pc < K; pc += GEMM_KC) {
+            size_t kc = std::min(GEMM_KC, K - pc);
+            gemmPackB(&B[pc * ldb + jc], ldb, kc, nc, nr, packedB);
+            threadPool().run(blocks, [&](size_t block) {
+                static thread_local GemmBuffer bufA;
+                size_t ic = block * GEMM_MC;
+                size_t mc = std::min(GEMM_MC, M - ic);
+                gemmBlock(isa, mc, nc, kc, &A[ic * lda + pc], lda, alpha, packedB, &C[ic * ldc + jc], ldc,
+                          bufA.get(GEMM_MC * GEMM_KC));
+            });
+        }
+    }
+}
+
+/* То же с ядром, выбранным при запуске (gemmActiveIsa). */
+template <class TA, class TB>
+inline void gemm(size_t M, size_t N, size_t K, const TA* A, size_t lda, const TB* B, size_t ldb,
+                 float* C, size_t ldc, bool accumulate = false, float alpha = 1.0f) {
+    gemmWithIsa(gemmActiveIsa(), M, N, K, A, lda, B, ldb, C, ldc, accumulate, alpha);
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef LAB7_MATRIX_OPS_H
+#define LAB7_MATRIX_OPS_H
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include "ops_avx2.h"
+#include "ops_scalar.h"
+#include "ops_sse.h"
+#include "strassen.h"
+#include "workspace.h"
+#ifdef WITH_CBLAS
+#include "ops_cblas.h"
+#endif
+
+/*
+ * Общий интерфейс матричных операций lab7. Каждая реализация (scalar, sse,
+ * avx2, cblas) живёт в своём пространстве имён ops_*.h, strassen - в
+ * strassen.h, а здесь они собраны в таблицу указателей, по которой
+ * invertMatrix выполняет обращение рядом.
+ * Программы blas.cpp и without_manual_vectorization.cpp используют те же
+ * функции напрямую, так что реализации не расходятся.
+ */
+struct MatrixOps {
+    const char* name;
+    bool (*supported)();
+    void (*add)(const float* A, const float* B, float* Res, size_t N);
+    void (*sub)(const float* A, const float* B, float* Res, size_t N);
+    void (*mul)(const float* A, const float* B, float* Res, size_t N);
+    void (*div)(const float* A, float* Res, float k, size_t N);
+    void (*transpose)(const float* A, float* AT, size_t N);
+    float (*maxRowSum)(const float* A, size_t N);
+    float (*maxColumnSum)(const float* A, size_t N);
+    void (*identity)(float* Res, size_t N);
+};
+
+inline bool matrixOpsAlways() {
+    return true;
+}
+
+#define LAB7_MATRIX_OPS(ns, supported) \
+    { #ns, supported, ns::addMatrix, ns::subMatrix, ns::mulMatrix, ns::divMatrix, ns::transposeMatrix, \
+      ns::findMaxAbsSumByRows, ns::findMaxAbsSumByColumns, ns::initIdentityMatrix }
+
+/* Все собранные реализации; первая - эталонная scalar. */
+inline const MatrixOps* matrixOpsList(size_t& count) {
+    static const MatrixOps list[] = {
+        LAB7_MATRIX_OPS(scalar, matrixOpsAlways),
+        LAB7_MATRIX_OPS(sse, matrixOpsAlways),
+        LAB7_MATRIX_OPS(avx2, avx2::supported),
+        LAB7_MATRIX_OPS(strassen, matrixOpsAlways),
+#ifdef WITH_CBLAS
+        LAB7_MATRIX_OPS(blas, matrixOpsAlways),
+#endif
+    };
+    count = sizeof(list) / sizeof(list[0]);
+    return list;
+}
+
+inline const MatrixOps* matrixOpsByName(const char* name) {
+    size_t count;
+    const MatrixOps* list = matrixOpsList(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (strcmp(list[i].name, name) == 0 && list[i].supported()) {
+            return &list[i];
+        }
+    }
+    return nullptr;
+}
+
+/* Лучшая из векторных реализаций, доступных на этом процессоре. */
+inline const MatrixOps& matrixOpsDefault() {
+    const MatrixOps* ops = matrixOpsByName("avx2");
+    return ops ? *ops : *matrixOpsByName("sse");
+}
+
+enum { OPS_B, OPS_R, OPS_SUM, OPS_POWER, OPS_POWER_NEXT, OPS_COUNT };
+
+/* Обращение рядом из M членов, как matrixConversion; возвращает время в секундах. */
+inline double invertMatrix(const MatrixOps& ops, const float* A, float* Res, const size_t N, const size_t M) {
+    Workspace& ws = workspace();
+    ws.reserve(OPS_COUNT, N);
+    float* B = ws.matrix(OPS_B);
+    float* R = ws.matrix(OPS_R);
+    float* sum = ws.matrix(OPS_SUM);
+    float* tmp = ws.matrix(OPS_POWER);
+    float* tmp2 = ws.matrix(OPS_POWER_NEXT);
+
+    auto start = std::chrono::steady_clock::now();
+    ops.transpose(A, B, N);
+    ops.div(B, B, ops.maxColumnSum(A, N) * ops.maxRowSum(A, N), N);
+    ops.mul(B, A, tmp, N);
+    ops.identity(sum, N);
+    ops.sub(sum, tmp, R, N);
+
+    float* power = R;
+    for (size_t i = 1; i < M; ++i) {
+        ops.add(sum, power, sum, N);
+        if (i < M - 1) {
+            ops.mul(power, R, tmp, N);
+            power = tmp;
+            std::swap(tmp, tmp2);
+        }
+    }
+    ops.mul(sum, B, Res, N);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif
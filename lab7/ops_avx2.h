@@ -0,0 +1,178 @@
+#ifndef LAB7_OPS_AVX2_H
+#define LAB7_OPS_AVX2_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <immintrin.h>
+#include "gemm.h"
+#include "thread_pool.h"
+
+/*
+ * Матричные операции на AVX2; умножение - GEMM с AVX2-микроядром. Лямбды
+ * parallelRows не наследуют target, поэтому векторный код вынесен в функции
+ * над диапазоном строк с атрибутом target("avx2,fma").
+ */
+namespace avx2 {
+
+using std::max_element;
+using std::vector;
+
+inline bool supported() {
+    return gemmIsaSupported(GEMM_AVX2);
+}
+
+__attribute__((target("avx2,fma")))
+inline void addRows(const float* A, const float* B, float* Res, float sign, size_t first, size_t last) {
+    __m256 vecSign = _mm256_set1_ps(sign);
+    size_t i = first;
+    for (; i + 8 <= last; i += 8) {
+        _mm256_storeu_ps(&Res[i], _mm256_fmadd_ps(vecSign, _mm256_loadu_ps(&B[i]), _mm256_loadu_ps(&A[i])));
+    }
+    for (; i < last; ++i) {
+        Res[i] = A[i] + sign * B[i];
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline void divRows(const float* A, float* Res, float k, size_t first, size_t last) {
+    __m256 vecK = _mm256_set1_ps(k);
+    size_t i = first;
+    for (; i + 8 <= last; i += 8) {
+        _mm256_storeu_ps(&Res[i], _mm256_div_ps(_mm256_loadu_ps(&A[i]), vecK));
+    }
+    for (; i < last; ++i) {
+        Res[i] = A[i] / k;
+    }
+}
+
+/* Транспонирование блоками 8 x 8 для строк first..last (кратных 8). */
+__attribute__((target("avx2,fma")))
+inline void transposeRows(const float* A, float* AT, size_t N, size_t first, size_t last) {
+    for (size_t i = first; i < last; i += 8) {
+        for (size_t j = 0; j < N; j += 8) {
+            __m256 r[8], t[8];
+            for (size_t k = 0; k < 8; ++k) {
+                r[k] = _mm256_loadu_ps(&A[(i + k) * N + j]);
+            }
+            for (size_t k = 0; k < 8; k += 2) {
+                t[k] = _mm256_unpacklo_ps(r[k], r[k + 1]);
+                t[k + 1] = _mm256_unpackhi_ps(r[k], r[k + 1]);
+            }
+            for (size_t k = 0; k < 8; k += 4) {
+                r[k] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(1, 0, 1, 0));
+                r[k + 1] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(3, 2, 3, 2));
+                r[k + 2] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(1, 0, 1, 0));
+                r[k + 3] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(3, 2, 3, 2));
+            }
+            for (size_t k = 0; k < 4; ++k) {
+                _mm256_storeu_ps(&AT[(j + k) * N + i], _mm256_permute2f128_ps(r[k], r[k + 4], 0x20));
+                _mm256_storeu_ps(&AT[(j + k + 4) * N + i], _mm256_permute2f128_ps(r[k], r[k + 4], 0x31));
+            }
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline void rowSums(const float* A, float* sums, size_t N, size_t first, size_t last) {
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    for (size_t i = first; i < last; ++i) {
+        __m256 vecSum = _mm256_setzero_ps();
+        size_t j = 0;
+        for (; j + 8 <= N; j += 8) {
+            vecSum = _mm256_add_ps(vecSum, _mm256_and_ps(mask, _mm256_loadu_ps(&A[i * N + j])));
+        }
+        alignas(32) float sumArr[8];
+        _mm256_store_ps(sumArr, vecSum);
+        float sum = 0;
+        for (size_t k = 0; k < 8; ++k) {
+            sum += sumArr[k];
+        }
+        for (; j < N; ++j) {
+            sum += fabsf(A[i * N + j]);
+        }
+        sums[i] = sum;
+    }
+}
+
+/* Суммы столбцов first..last, проход по всем строкам. */
+__attribute__((target("avx2,fma")))
+inline void columnSums(const float* A, float* sums, size_t N, size_t first, size_t last) {
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    for (size_t j = 0; j < N; ++j) {
+        size_t i = first;
+        for (; i + 8 <= last; i += 8) {
+            __m256 vecA = _mm256_and_ps(mask, _mm256_loadu_ps(&A[j * N + i]));
+            _mm256_storeu_ps(&sums[i], _mm256_add_ps(_mm256_loadu_ps(&sums[i]), vecA));
+        }
+        for (; i < last; ++i) {
+            sums[i] += fabsf(A[j * N + i]);
+        }
+    }
+}
+
+inline void addMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        addRows(A, B, Res, 1.0f, first * N, last * N);
+    });
+}
+
+inline void subMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        addRows(A, B, Res, -1.0f, first * N, last * N);
+    });
+}
+
+inline void mulMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    gemmWithIsa(GEMM_AVX2, N, N, N, A, N, B, N, Res, N);
+}
+
+inline void divMatrix(const float* A, float* Res, const float k, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        divRows(A, Res, k, first * N, last * N);
+    });
+}
+
+inline void transposeMatrix(const float* A, float* AT, const size_t N) {
+    if (N % 8 != 0) {
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                AT[j * N + i] = A[i * N + j];
+            }
+        }
+        return;
+    }
+    parallelRows(N, [&](size_t first, size_t last) {
+        transposeRows(A, AT, N, first, last);
+    }, 8);
+}
+
+inline float findMaxAbsSumByRows(const float* A, const size_t N) {
+    vector<float> sums(N);
+    parallelRows(N, [&](size_t first, size_t last) {
+        rowSums(A, sums.data(), N, first, last);
+    });
+    return *max_element(sums.begin(), sums.end());
+}
+
+inline float findMaxAbsSumByColumns(const float* A, const size_t N) {
+    vector<float> sums(N, 0.0f);
+    parallelRows(N, [&](size_t first, size_t last) {
+        columnSums(A, sums.data(), N, first, last);
+    }, 16);
+    return *max_element(sums.begin(), sums.end());
+}
+
+inline void initIdentityMatrix(float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        memset(&Res[first * N], 0, (last - first) * N * sizeof(float));
+        for (size_t i = first; i < last; ++i) {
+            Res[i * N + i] = 1.0f;
+        }
+    });
+}
+
+}
+
+#endif
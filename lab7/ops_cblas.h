@@ -0,0 +1,110 @@
+#ifndef LAB7_OPS_CBLAS_H
+#define LAB7_OPS_CBLAS_H
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <cblas.h>
+#include "thread_pool.h"
+
+namespace blas {
+
+using std::max_element;
+using std::vector;
+
+/*
+ * Каждая функция делит матрицу на полосы строк и вызывает BLAS для своей
+ * полосы в потоке общего пула. Чтобы потоки OpenBLAS не конкурировали с
+ * пулом, при пуле больше одного потока OpenBLAS переводится в однопоточный
+ * режим (см. useThreads).
+ */
+inline void useThreads(size_t poolThreads, size_t blasThreads) {
+    threadPool().resize(poolThreads);
+#ifdef OPENBLAS_VERSION
+    openblas_set_num_threads(static_cast<int>(blasThreads));
+#else
+    (void) blasThreads;
+#endif
+}
+
+inline void addMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        if (A != Res) {
+            cblas_scopy((last - first) * N, &A[first * N], 1, &Res[first * N], 1);
+        }
+        cblas_saxpy((last - first) * N, 1.0f, &B[first * N], 1, &Res[first * N], 1);
+    });
+}
+
+inline void subMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        if (A != Res) {
+            cblas_scopy((last - first) * N, &A[first * N], 1, &Res[first * N], 1);
+        }
+        cblas_saxpy((last - first) * N, -1.0f, &B[first * N], 1, &Res[first * N], 1);
+    });
+}
+
+inline void mulMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+                    last - first, N, N,
+                    1.0f,
+                    &A[first * N], N,
+                    B, N,
+                    0.0f,
+                    &Res[first * N], N);
+    });
+}
+
+
+inline void divMatrix(const float* A, float* Res, const float k, const size_t N) {
+    float inv_k = 1.0f / k;
+    parallelRows(N, [&](size_t first, size_t last) {
+        if (A != Res) {
+            cblas_scopy((last - first) * N, &A[first * N], 1, &Res[first * N], 1);
+        }
+        cblas_sscal((last - first) * N, inv_k, &Res[first * N], 1);
+    });
+}
+
+inline void transposeMatrix(const float* A, float* AT, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            cblas_scopy(N, &A[i * N], 1, &AT[i], N);
+        }
+    });
+}
+
+inline float findMaxAbsSumByRows(const float* A, const size_t N) {
+    vector<float> sums(N);
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            sums[i] = cblas_sasum(N, &A[i * N], 1);
+        }
+    });
+    return *max_element(sums.begin(), sums.end());
+}
+
+inline float findMaxAbsSumByColumns(const float* A, const size_t N) {
+    vector<float> sums(N);
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            sums[i] = cblas_sasum(N, &A[i], N);
+        }
+    });
+    return *max_element(sums.begin(), sums.end());
+}
+
+inline void initIdentityMatrix(float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        memset(&Res[first * N], 0, (last - first) * N * sizeof(float));
+        for (size_t i = first; i < last; ++i) {
+            Res[i * N + i] = 1.0f;
+        }
+    });
+}
+
+}
+
+#endif
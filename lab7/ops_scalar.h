@@ -0,0 +1,109 @@
+#ifndef LAB7_OPS_SCALAR_H
+#define LAB7_OPS_SCALAR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "thread_pool.h"
+
+/* Матричные операции без ручной векторизации: эталон для остальных реализаций. */
+namespace scalar {
+
+using std::max_element;
+using std::vector;
+
+inline void addMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                Res[i * N + j] = A[i * N + j] + B[i * N + j];
+            }
+        }
+    });
+}
+
+inline void subMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                Res[i * N + j] = A[i * N + j] - B[i * N + j];
+            }
+        }
+    });
+}
+
+inline void mulMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first * N; i < last * N; i++) {
+            Res[i] = 0.0f;
+        }
+        for (size_t i = first; i < last; i++) {
+            for (size_t j = 0; j < N; j++) {
+                for (size_t k = 0; k < N; k++) {
+                    Res[i * N + j] += A[i * N + k] * B[k * N + j];
+                }
+            }
+        }
+    });
+}
+
+inline void divMatrix(const float* A, float* Res, const float k, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                Res[i * N + j] = A[i * N + j] / k;
+            }
+        }
+    });
+}
+
+inline void transposeMatrix(const float* A, float* AT, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                AT[j * N + i] = A[i * N + j];
+            }
+        }
+    });
+}
+
+inline float findMaxAbsSumByRows(const float* A, const size_t N) {
+    vector<float> sums(N);
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            float sum = 0;
+            for (size_t j = 0; j < N; ++j) {
+                sum += fabsf(A[i * N + j]);
+            }
+            sums[i] = sum;
+        }
+    });
+    return *max_element(sums.begin(), sums.end());
+}
+
+// Каждый поток получает полосу столбцов и копит их суммы, проходя по строкам.
+inline float findMaxAbsSumByColumns(const float* A, const size_t N) {
+    vector<float> sums(N, 0.0f);
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t j = 0; j < N; ++j) {
+            for (size_t i = first; i < last; ++i) {
+                sums[i] += fabsf(A[j * N + i]);
+            }
+        }
+    }, 16);
+    return *max_element(sums.begin(), sums.end());
+}
+
+inline void initIdentityMatrix(float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        memset(&Res[first * N], 0, (last - first) * N * sizeof(float));
+        for (size_t i = first; i < last; ++i) {
+            Res[i * N + i] = 1;
+        }
+    });
+}
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef LAB7_OPS_SSE_H
+#define LAB7_OPS_SSE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <immintrin.h>
+#include "gemm.h"
+#include "thread_pool.h"
+
+/* Матричные операции на SSE; умножение - GEMM с SSE-микроядром. */
+namespace sse {
+
+using std::max_element;
+using std::vector;
+
+inline void addMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        size_t i = first * N;
+        for (; i + 4 <= last * N; i += 4) {
+            __m128 vecA = _mm_loadu_ps(&A[i]);
+            __m128 vecB = _mm_loadu_ps(&B[i]);
+            __m128 vecRes = _mm_add_ps(vecA, vecB);
+            _mm_storeu_ps(&Res[i], vecRes);
+        }
+        for (; i < last * N; ++i) {
+            Res[i] = A[i] + B[i];
+        }
+    });
+}
+
+inline void subMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        size_t i = first * N;
+        for (; i + 4 <= last * N; i += 4) {
+            __m128 vecA = _mm_loadu_ps(&A[i]);
+            __m128 vecB = _mm_loadu_ps(&B[i]);
+            __m128 vecRes = _mm_sub_ps(vecA, vecB);
+            _mm_storeu_ps(&Res[i], vecRes);
+        }
+        for (; i < last * N; ++i) {
+            Res[i] = A[i] - B[i];
+        }
+    });
+}
+
+inline void divMatrix(const float* A, float* Res, const float k, const size_t N) {
+    __m128 vecK = _mm_set1_ps(k);
+    parallelRows(N, [&](size_t first, size_t last) {
+        size_t i = first * N;
+        for (; i + 4 <= last * N; i += 4) {
+            __m128 vecA = _mm_loadu_ps(&A[i]);
+            __m128 vecRes = _mm_div_ps(vecA, vecK);
+            _mm_storeu_ps(&Res[i], vecRes);
+        }
+        for (; i < last * N; ++i) {
+            Res[i] = A[i] / k;
+        }
+    });
+}
+
+// Блоки 4 x 4 там, где они целиком внутри матрицы; остаток столбцов и
+// строк при N, не кратном 4, переносится поэлементно.
+inline void transposeMatrix(const float* A, float* AT, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        size_t i = first;
+        for (; i + 4 <= last; i += 4) {
+            size_t j = 0;
+            for (; j + 4 <= N; j += 4) {
+                __m128 row0 = _mm_loadu_ps(&A[i * N + j]);
+                __m128 row1 = _mm_loadu_ps(&A[(i + 1) * N + j]);
+                __m128 row2 = _mm_loadu_ps(&A[(i + 2) * N + j]);
+                __m128 row3 = _mm_loadu_ps(&A[(i + 3) * N + j]);
+
+                __m128 tmp0 = _mm_unpacklo_ps(row0, row1);
+                __m128 tmp1 = _mm_unpackhi_ps(row0, row1);
+                __m128 tmp2 = _mm_unpacklo_ps(row2, row3);
+                __m128 tmp3 = _mm_unpackhi_ps(row2, row3);
+
+                _mm_storeu_ps(&AT[j * N + i], _mm_movelh_ps(tmp0, tmp2));
+                _mm_storeu_ps(&AT[(j + 1) * N + i], _mm_movehl_ps(tmp2, tmp0));
+                _mm_storeu_ps(&AT[(j + 2) * N + i], _mm_movelh_ps(tmp1, tmp3));
+                _mm_storeu_ps(&AT[(j + 3) * N + i], _mm_movehl_ps(tmp3, tmp1));
+            }
+            for (; j < N; ++j) {
+                for (size_t k = i; k < i + 4; ++k) {
+                    AT[j * N + k] = A[k * N + j];
+                }
+            }
+        }
+        for (; i < last; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                AT[j * N + i] = A[i * N + j];
+            }
+        }
+    }, 4);
+}
+
+inline float findMaxAbsSumByRows(const float* A, const size_t N) {
+    vector<float> sums(N);
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            __m128 vecSum = _mm_setzero_ps();
+            size_t j = 0;
+            for (; j + 3 < N; j += 4) {
+                __m128 vecA = _mm_loadu_ps(&A[i * N + j]);
+                vecA = _mm_andnot_ps(_mm_set1_ps(-0.0f), vecA);
+                vecSum = _mm_add_ps(vecSum, vecA);
+            }
+            float sumArr[4];
+            _mm_storeu_ps(sumArr, vecSum);
+            float sum = sumArr[0] + sumArr[1] + sumArr[2] + sumArr[3];
+            for (; j < N; ++j) {
+                sum += fabsf(A[i * N + j]);
+            }
+            sums[i] = sum;
+        }
+    });
+    return *max_element(sums.begin(), sums.end());
+}
+
+// Столбцы делятся на полосы: каждый поток идёт по строкам своей полосы
+// и копит суммы в собственном диапазоне sums, так что редукция не нужна.
+inline float findMaxAbsSumByColumns(const float* A, const size_t N) {
+    vector<float> sums(N, 0.0f);
+    parallelRows(N, [&](size_t first, size_t last) {
+        for (size_t j = 0; j < N; ++j) {
+            size_t i = first;
+            for (; i + 3 < last; i += 4) {
+                __m128 vecA = _mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_loadu_ps(&A[j * N + i]));
+                _mm_storeu_ps(&sums[i], _mm_add_ps(_mm_loadu_ps(&sums[i]), vecA));
+            }
+            for (; i < last; ++i) {
+                sums[i] += fabsf(A[j * N + i]);
+            }
+        }
+    }, 16);
+    return *max_element(sums.begin(), sums.end());
+}
+
+inline void initIdentityMatrix(float* Res, const size_t N) {
+    parallelRows(N, [&](size_t first, size_t last) {
+        memset(&Res[first * N], 0, (last - first) * N * sizeof(float));
+        for (size_t i = first; i < last; ++i) {
+            Res[i * N + i] = 1.0f;
+        }
+    });
+}
+
+inline void mulMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    gemmWithIsa(GEMM_SSE, N, N, N, A, N, B, N, Res, N);
+}
+
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef LAB7_STRASSEN_H
+#define LAB7_STRASSEN_H
+
+#include <vector>
+#include "gemm.h"
+#include "ops_sse.h"
+#include "thread_pool.h"
+
+/*
+ * Умножение по Штрассену-Винограду: 7 умножений половинного размера и 15
+ * сложений на уровень. Рекурсия идёт, пока размер больше порога и чётный,
+ * дальше работает обычный gemm. Порядок вычислений взят из схемы Boyer,
+ * Dumas, Pernet, Zhou: промежуточные результаты хранятся в четвертях C,
+ * и на каждый уровень нужны только два временных блока X и Y размером
+ * (n/2) x (n/2). Все уровни выделяются заранее одним куском в
+ * StrassenWorkspace; рабочая область общая, поэтому strassenMul нельзя
+ * вызывать из нескольких потоков одновременно.
+ *
+ * Ошибка растёт с числом уровней: каждое сложение четвертей добавляет
+ * округление к величинам порядка |A||B|, поэтому порог не стоит опускать
+ * ниже, чем нужно для выигрыша (см. --strassen-bench).
+ */
+
+inline size_t& strassenCutoff() {
+    static size_t cutoff = 512;
+    return cutoff;
+}
+
+class StrassenWorkspace {
+public:
+    /* Готовит временные блоки для всех уровней умножения N x N. */
+    void reserve(size_t N, size_t cutoff) {
+        offsets.clear();
+        halves.clear();
+        size_t total = 0;
+        for (size_t n = N; n > cutoff && n % 2 == 0; n /= 2) {
+            offsets.push_back(total);
+            halves.push_back(n / 2);
+            total += 2 * (n / 2) * (n / 2);
+        }
+        base = buffer.get(total);
+    }
+
+    size_t levels() const {
+        return offsets.size();
+    }
+
+    float* x(size_t level) const {
+        return base + offsets[level];
+    }
+
+    float* y(size_t level) const {
+        return x(level) + halves[level] * halves[level];
+    }
+
+private:
+    GemmBuffer buffer;
+    std::vector<size_t> offsets;
+    std::vector<size_t> halves;
+    float* base = nullptr;
+};
+
+inline StrassenWorkspace& strassenWorkspace() {
+    static StrassenWorkspace ws;
+    return ws;
+}
+
+/* Z = X + sign * Y для блоков h x h со своими шагами строк. */
+inline void strassenCombine(size_t h, const float* X, size_t ldx, const float* Y, size_t ldy, float sign,
+                            float* Z, size_t ldz) {
+    parallelRows(h, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const float* x = &X[i * ldx];
+            const float* y = &Y[i * ldy];
+            float* z = &Z[i * ldz];
+            for (size_t j = 0; j < h; ++j) {
+                z[j] = x[j] + sign * y[j];
+            }
+        }
+    });
+}
+
+inline void strassenLevel(size_t level, size_t n, size_t cutoff, const float* A, size_t lda, const float* B,
+                          size_t ldb, float* C, size_t ldc) {
+    StrassenWorkspace& ws = strassenWorkspace();
+    if (level >= ws.levels() || n <= cutoff || n % 2 != 0) {
+        gemm(n, n, n, A, lda, B, ldb, C, ldc);
+        return;
+    }
+    const size_t h = n / 2;
+    const float* A11 = A;
+    const float* A12 = A + h;
+    const float* A21 = A + h * lda;
+    const float* A22 = A21 + h;
+    const float* B11 = B;
+    const float* B12 = B + h;
+    const float* B21 = B + h * ldb;
+    const float* B22 = B21 + h;
+    float* C11 = C;
+    float* C12 = C + h;
+    float* C21 = C + h * ldc;
+    float* C22 = C21 + h;
+    float* X = ws.x(level);
+    float* Y = ws.y(level);
+    auto mul = [&](const float* L, size_t ldl, const float* R, size_t ldr, float* P, size_t ldp) {
+        strassenLevel(level + 1, h, cutoff, L, ldl, R, ldr, P, ldp);
+    };
+
+    strassenCombine(h, A11, lda, A21, lda, -1.0f, X, h);     // S3
+    strassenCombine(h, B22, ldb, B12, ldb, -1.0f, Y, h);     // T3
+    mul(X, h, Y, h, C21, ldc);                               // P7
+    strassenCombine(h, A21, lda, A22, lda, 1.0f, X, h);      // S1
+    strassenCombine(h, B12, ldb, B11, ldb, -1.0f, Y, h);     // T1
+    mul(X, h, Y, h, C22, ldc);                               // P5
+    strassenCombine(h, X, h, A11, lda, -1.0f, X, h);         // S2 = S1 - A11
+    strassenCombine(h, B22, ldb, Y, h, -1.0f, Y, h);         // T2 = B22 - T1
+    mul(X, h, Y, h, C12, ldc);                               // P6
+    strassenCombine(h, A12, lda, X, h, -1.0f, X, h);         // S4 = A12 - S2
+    mul(X, h, B22, ldb, C11, ldc);                           // P3
+    mul(A11, lda, B11, ldb, X, h);                           // P1
+    strassenCombine(h, X, h, C12, ldc, 1.0f, C12, ldc);      // U2 = P1 + P6
+    strassenCombine(h, C12, ldc, C21, ldc, 1.0f, C21, ldc);  // U3 = U2 + P7
+    strassenCombine(h, C12, ldc, C22, ldc, 1.0f, C12, ldc);  // U4 = U2 + P5
+    strassenCombine(h, C21, ldc, C22, ldc, 1.0f, C22, ldc);  // U7 = U3 + P5
+    strassenCombine(h, C12, ldc, C11, ldc, 1.0f, C12, ldc);  // U5 = U4 + P3
+    strassenCombine(h, Y, h, B21, ldb, -1.0f, Y, h);         // T4 = T2 - B21
+    mul(A22, lda, Y, h, C11, ldc);                           // P4
+    strassenCombine(h, C21, ldc, C11, ldc, -1.0f, C21, ldc); // U6 = U3 - P4
+    mul(A12, lda, B21, ldb, C11, ldc);                       // P2
+    strassenCombine(h, X, h, C11, ldc, 1.0f, C11, ldc);      // U1 = P1 + P2
+}
+
+/* C = A * B для матриц N x N; cutoff - размер, с которого работает обычный gemm. */
+inline void strassenMul(const float* A, const float* B, float* C, size_t N, size_t cutoff) {
+    strassenWorkspace().reserve(N, cutoff);
+    strassenLevel(0, N, cutoff, A, N, B, N, C, N);
+}
+
+/* Реализация MatrixOps: SSE-операции и умножение по Штрассену с порогом strassenCutoff(). */
+namespace strassen {
+
+using sse::addMatrix;
+using sse::subMatrix;
+using sse::divMatrix;
+using sse::transposeMatrix;
+using sse::findMaxAbsSumByRows;
+using sse::findMaxAbsSumByColumns;
+using sse::initIdentityMatrix;
+
+inline void mulMatrix(const float* A, const float* B, float* Res, const size_t N) {
+    strassenMul(A, B, Res, N, strassenCutoff());
+}
+
+}
+
+#endif
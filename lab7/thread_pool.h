@@ -0,0 +1,164 @@
+#ifndef LAB7_THREAD_POOL_H
+#define LAB7_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Пул потоков, создаваемый один раз на всю программу. run(count, task)
+ * раздаёт индексы 0..count-1 рабочим потокам и вызывающему потоку
+ * через общий атомарный счётчик и возвращается, когда все задачи выполнены.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads) {
+        start(threads);
+    }
+
+    ~ThreadPool() {
+        stop();
+    }
+
+    size_t size() const {
+        return workers.size() + 1;
+    }
+
+    void resize(size_t threads) {
+        if (threads != size()) {
+            stop();
+            start(threads);
+        }
+    }
+
+    void run(size_t count, const std::function<void(size_t)>& task) {
+        if (count == 0) {
+            return;
+        }
+        if (workers.empty() || count == 1 || insideTask()) {
+            for (size_t i = 0; i < count; ++i) {
+                task(i);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = &task;
+            total = count;
+            next.store(0);
+            pending = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+        work();
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+        current = nullptr;
+    }
+
+private:
+    // Новые потоки начинают с текущего поколения, иначе после resize()
+    // они проснулись бы на давно завершённый run() и сбили счётчик pending.
+    void start(size_t threads) {
+        size_t seen;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = false;
+            seen = generation;
+        }
+        for (size_t i = 1; i < std::max<size_t>(threads, 1); ++i) {
+            workers.emplace_back([this, seen] { loop(seen); });
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::thread& w : workers) {
+            w.join();
+        }
+        workers.clear();
+    }
+
+    // Вложенный run() из задачи выполняется последовательно в том же потоке.
+    static bool& insideTask() {
+        static thread_local bool inside = false;
+        return inside;
+    }
+
+    void work() {
+        insideTask() = true;
+        for (size_t i = next.fetch_add(1); i < total; i = next.fetch_add(1)) {
+            (*current)(i);
+        }
+        insideTask() = false;
+    }
+
+    void loop(size_t seen) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return quit || generation != seen; });
+                if (quit) {
+                    return;
+                }
+                seen = generation;
+            }
+            work();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* current = nullptr;
+    std::atomic<size_t> next{0};
+    size_t total = 0;
+    size_t pending = 0;
+    size_t generation = 0;
+    bool quit = false;
+};
+
+/* Общий пул; размер по умолчанию берётся из LAB7_THREADS или числа ядер. */
+inline ThreadPool& threadPool() {
+    static ThreadPool pool([] {
+        const char* env = getenv("LAB7_THREADS");
+        size_t threads = env ? static_cast<size_t>(atoi(env)) : std::thread::hardware_concurrency();
+        return std::max<size_t>(threads, 1);
+    }());
+    return pool;
+}
+
+/*
+ * Делит строки 0..rows на полосы по tile строк (tile кратно align) и
+ * вызывает body(first, last) для каждой полосы в пуле.
+ */
+template <class Body>
+void parallelRows(size_t rows, Body body, size_t align = 1) {
+    ThreadPool& pool = threadPool();
+    size_t tiles = std::min(rows / align, pool.size() * 4);
+    if (tiles <= 1) {
+        body(0, rows);
+        return;
+    }
+    size_t tile = (rows / align + tiles - 1) / tiles * align;
+    tiles = (rows + tile - 1) / tile;
+    pool.run(tiles, [&](size_t t) {
+        body(t * tile, std::min(rows, (t + 1) * tile));
+    });
+}
+
+#endif
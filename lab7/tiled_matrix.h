@@ -0,0 +1,572 @@
+#ifndef LAB7_TILED_MATRIX_H
+#define LAB7_TILED_MATRIX_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "gemm.h"
+#include "ops_sse.h"
+
+/*
+ * Матрицы, которые не помещаются в память. Матрица n x n хранится в файле
+ * плитками tile x tile (каждая плитка - непрерывные tile * tile float, плитки
+ * идут построчно), край дополняется нулями. Операции проходят по плиткам в
+ * заранее известном порядке: TileStream читает следующие плитки в
+ * отдельном потоке в кольцо из depth буферов, а TileWriter пишет готовые
+ * плитки в фоне через такое же кольцо. Сложение и транспонирование держат в
+ * памяти 2 * depth + 1 плиток независимо от n; умножению дополнительно
+ * нужен кэш строк плиток A (см. tiledMul), не меньше одной строки - n / tile
+ * плиток.
+ *
+ * С direct файл открывается с O_DIRECT, и чтение идёт мимо page cache
+ * (tile должен быть кратен 32, чтобы плитка была кратна 4 КБ).
+ */
+
+struct TiledStats {
+    std::atomic<size_t> bytesRead{0};
+    std::atomic<size_t> bytesWritten{0};
+    std::atomic<size_t> flops{0};
+    /* Ожидание чтения (next) и записи (write) в вычисляющем потоке. */
+    double stallSeconds = 0;
+};
+
+inline TiledStats& tiledStats() {
+    static TiledStats stats;
+    return stats;
+}
+
+inline float* tileAlloc(size_t floats) {
+    void* p = aligned_alloc(4096, (floats * sizeof(float) + 4095) / 4096 * 4096);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return static_cast<float*>(p);
+}
+
+class TiledMatrix {
+public:
+    TiledMatrix(const std::string& path, size_t n, size_t tile, bool direct)
+        : path(path), n(n), tile(tile), tiles((n + tile - 1) / tile) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0600);
+        if (fd < 0 && direct) {
+            fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        }
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(tiles * tiles * tileBytes())) != 0) {
+            throw std::runtime_error("cannot create " + path);
+        }
+    }
+
+    ~TiledMatrix() {
+        close(fd);
+        unlink(path.c_str());
+    }
+
+    TiledMatrix(const TiledMatrix&) = delete;
+    TiledMatrix& operator=(const TiledMatrix&) = delete;
+
+    size_t size() const {
+        return n;
+    }
+
+    size_t tileSize() const {
+        return tile;
+    }
+
+    size_t tileCount() const {
+        return tiles;
+    }
+
+    size_t tileFloats() const {
+        return tile * tile;
+    }
+
+    size_t tileBytes() const {
+        return tileFloats() * sizeof(float);
+    }
+
+    void readTile(size_t ti, size_t tj, float* buf) const {
+        transfer(ti, tj, buf, false);
+        tiledStats().bytesRead += tileBytes();
+    }
+
+    void writeTile(size_t ti, size_t tj, const float* buf) {
+        transfer(ti, tj, const_cast<float*>(buf), true);
+        tiledStats().bytesWritten += tileBytes();
+    }
+
+    /* Копирование из обычной построчной матрицы n x n и обратно. */
+    void load(const float* A) {
+        float* buf = tileAlloc(tileFloats());
+        for (size_t ti = 0; ti < tiles; ++ti) {
+            for (size_t tj = 0; tj < tiles; ++tj) {
+                memset(buf, 0, tileBytes());
+                for (size_t r = 0; r < rowsIn(ti); ++r) {
+                    memcpy(&buf[r * tile], &A[(ti * tile + r) * n + tj * tile], rowsIn(tj) * sizeof(float));
+                }
+                writeTile(ti, tj, buf);
+            }
+        }
+        free(buf);
+    }
+
+    void store(float* A) const {
+        float* buf = tileAlloc(tileFloats());
+        for (size_t ti = 0; ti < tiles; ++ti) {
+            for (size_t tj = 0; tj < tiles; ++tj) {
+                readTile(ti, tj, buf);
+                for (size_t r = 0; r < rowsIn(ti); ++r) {
+                    memcpy(&A[(ti * tile + r) * n + tj * tile], &buf[r * tile], rowsIn(tj) * sizeof(float));
+                }
+            }
+        }
+        free(buf);
+    }
+
+    /* Сколько строк (столбцов) плитки с номером t лежит внутри n. */
+    size_t rowsIn(size_t t) const {
+        return std::min(tile, n - t * tile);
+    }
+
+private:
+    void transfer(size_t ti, size_t tj, float* buf, bool write) const {
+        char* p = reinterpret_cast<char*>(buf);
+        size_t left = tileBytes();
+        off_t offset = static_cast<off_t>((ti * tiles + tj) * tileBytes());
+        while (left > 0) {
+            ssize_t done = write ? pwrite(fd, p, left, offset) : pread(fd, p, left, offset);
+            if (done <= 0) {
+                throw std::runtime_error("I/O error on " + path);
+            }
+            p += done;
+            left -= static_cast<size_t>(done);
+            offset += done;
+        }
+    }
+
+    std::string path;
+    size_t n;
+    size_t tile;
+    size_t tiles;
+    int fd = -1;
+};
+
+struct TileRef {
+    const TiledMatrix* matrix;
+    size_t ti;
+    size_t tj;
+};
+
+/*
+ * Чтение плиток в заданном порядке с опережением: поток ввода-вывода
+ * заполняет кольцо из depth буферов, next() отдаёт очередную плитку,
+ * release() возвращает самые старые из выданных. Одновременно можно держать
+ * не больше depth - 1 плиток. Время ожидания next() копится в stallSeconds.
+ */
+class TileStream {
+public:
+    TileStream(std::vector<TileRef> order, size_t tileFloats, size_t depth)
+        : order(std::move(order)), depth(std::max<size_t>(depth, 3)) {
+        for (size_t i = 0; i < this->depth; ++i) {
+            buffers.push_back(tileAlloc(tileFloats));
+        }
+        reader = std::thread([this] { readAll(); });
+    }
+
+    ~TileStream() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        changed.notify_all();
+        reader.join();
+        for (float* b : buffers) {
+            free(b);
+        }
+    }
+
+    /* Следующая плитка; указатель действителен до соответствующего release(). */
+    const float* next() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (loaded <= taken) {
+            auto start = std::chrono::steady_clock::now();
+            changed.wait(lock, [this] { return loaded > taken || failed; });
+            tiledStats().stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (failed) {
+            throw std::runtime_error("tile read failed");
+        }
+        return buffers[taken++ % depth];
+    }
+
+    void release(size_t count = 1) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            released += count;
+        }
+        changed.notify_all();
+    }
+
+private:
+    void readAll() {
+        for (size_t i = 0; i < order.size(); ++i) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return quit || i < released + depth; });
+                if (quit) {
+                    return;
+                }
+            }
+            try {
+                order[i].matrix->readTile(order[i].ti, order[i].tj, buffers[i % depth]);
+            } catch (const std::exception&) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed = true;
+                changed.notify_all();
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            ++loaded;
+            changed.notify_all();
+        }
+    }
+
+    std::vector<TileRef> order;
+    size_t depth;
+    std::vector<float*> buffers;
+    std::thread reader;
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t loaded = 0;
+    size_t taken = 0;
+    size_t released = 0;
+    bool quit = false;
+    bool failed = false;
+};
+
+/*
+ * Запись плиток в фоне: write() копирует плитку в свободный буфер кольца из
+ * depth буферов (ожидание свободного буфера копится в stallSeconds), поток
+ * записи отправляет их в файл по порядку. flush() дожидается записи всех
+ * плиток; его нужно вызвать до того, как результат будет читаться.
+ */
+class TileWriter {
+public:
+    TileWriter(size_t tileFloats, size_t depth) : tileFloats(tileFloats), depth(std::max<size_t>(depth, 2)) {
+        for (size_t i = 0; i < this->depth; ++i) {
+            buffers.push_back(tileAlloc(tileFloats));
+            jobs.push_back({nullptr, 0, 0});
+        }
+        writer = std::thread([this] { writeAll(); });
+    }
+
+    ~TileWriter() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return written == queued || failed; });
+            quit = true;
+        }
+        changed.notify_all();
+        writer.join();
+        for (float* b : buffers) {
+            free(b);
+        }
+    }
+
+    void write(TiledMatrix& matrix, size_t ti, size_t tj, const float* tile) {
+        size_t slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (queued - written == depth) {
+                auto start = std::chrono::steady_clock::now();
+                changed.wait(lock, [this] { return queued - written < depth || failed; });
+                tiledStats().stallSeconds +=
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            if (failed) {
+                throw std::runtime_error("tile write failed");
+            }
+            slot = queued % depth;
+        }
+        memcpy(buffers[slot], tile, tileFloats * sizeof(float));
+        jobs[slot] = {&matrix, ti, tj};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++queued;
+        }
+        changed.notify_all();
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (written < queued) {
+            auto start = std::chrono::steady_clock::now();
+            changed.wait(lock, [this] { return written == queued || failed; });
+            tiledStats().stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (failed) {
+            throw std::runtime_error("tile write failed");
+        }
+    }
+
+private:
+    struct Job {
+        TiledMatrix* matrix;
+        size_t ti;
+        size_t tj;
+    };
+
+    void writeAll() {
+        while (true) {
+            size_t slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return quit || written < queued; });
+                if (written == queued) {
+                    return;
+                }
+                slot = written % depth;
+            }
+            try {
+                jobs[slot].matrix->writeTile(jobs[slot].ti, jobs[slot].tj, buffers[slot]);
+            } catch (const std::exception&) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed = true;
+                changed.notify_all();
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            ++written;
+            changed.notify_all();
+        }
+    }
+
+    size_t tileFloats;
+    size_t depth;
+    std::vector<float*> buffers;
+    std::vector<Job> jobs;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t queued = 0;
+    size_t written = 0;
+    bool quit = false;
+    bool failed = false;
+};
+
+/*
+ * C = alpha * A * B, плюс единичная матрица при addIdentity. Строки плиток
+ * A читаются блоками по R строк и остаются в памяти, пока мимо проходят все
+ * столбцы B: каждая плитка B(k, j) умножается сразу на R плиток A(i, k), так
+ * что A читается с диска один раз, а B - tiles / R раз вместо 2 * tiles^3
+ * чтений при потоковом обходе. R выбирается так, чтобы блок A и R плиток
+ * сумм C уместились в cacheTiles плиток, но не меньше одной строки.
+ */
+inline size_t tiledPanelRows(size_t tiles, size_t cacheTiles) {
+    return std::min(tiles, std::max<size_t>(1, cacheTiles / (tiles + 1)));
+}
+
+inline void tiledMul(const TiledMatrix& A, const TiledMatrix& B, TiledMatrix& C, size_t depth, size_t cacheTiles,
+                     float alpha = 1.0f, bool addIdentity = false) {
+    const size_t tiles = A.tileCount();
+    const size_t T = A.tileSize();
+    const size_t R = tiledPanelRows(tiles, cacheTiles);
+    std::vector<TileRef> order;
+    for (size_t ti0 = 0; ti0 < tiles; ti0 += R) {
+        const size_t rows = std::min(R, tiles - ti0);
+        for (size_t r = 0; r < rows; ++r) {
+            for (size_t tk = 0; tk < tiles; ++tk) {
+                order.push_back({&A, ti0 + r, tk});
+            }
+        }
+        for (size_t tj = 0; tj < tiles; ++tj) {
+            for (size_t tk = 0; tk < tiles; ++tk) {
+                order.push_back({&B, tk, tj});
+            }
+        }
+    }
+    TileStream stream(std::move(order), A.tileFloats(), depth);
+    TileWriter writer(A.tileFloats(), depth);
+    std::vector<float*> panel(R * tiles), acc(R);
+    for (float*& p : panel) {
+        p = tileAlloc(A.tileFloats());
+    }
+    for (float*& p : acc) {
+        p = tileAlloc(A.tileFloats());
+    }
+    for (size_t ti0 = 0; ti0 < tiles; ti0 += R) {
+        const size_t rows = std::min(R, tiles - ti0);
+        for (size_t i = 0; i < rows * tiles; ++i) {
+            memcpy(panel[i], stream.next(), A.tileBytes());
+            stream.release();
+        }
+        for (size_t tj = 0; tj < tiles; ++tj) {
+            for (size_t r = 0; r < rows; ++r) {
+                memset(acc[r], 0, A.tileBytes());
+            }
+            for (size_t tk = 0; tk < tiles; ++tk) {
+                const float* b = stream.next();
+                for (size_t r = 0; r < rows; ++r) {
+                    gemm(T, T, T, panel[r * tiles + tk], T, b, T, acc[r], T, true, alpha);
+                    tiledStats().flops += 2 * A.rowsIn(ti0 + r) * A.rowsIn(tj) * A.rowsIn(tk);
+                }
+                stream.release();
+            }
+            for (size_t r = 0; r < rows; ++r) {
+                if (addIdentity && ti0 + r == tj) {
+                    for (size_t d = 0; d < A.rowsIn(tj); ++d) {
+                        acc[r][d * T + d] += 1.0f;
+                    }
+                }
+                writer.write(C, ti0 + r, tj, acc[r]);
+            }
+        }
+    }
+    writer.flush();
+    for (float* p : panel) {
+        free(p);
+    }
+    for (float* p : acc) {
+        free(p);
+    }
+}
+
+/* C = A + B поплиточно; C может совпадать с A или B. */
+inline void tiledAdd(const TiledMatrix& A, const TiledMatrix& B, TiledMatrix& C, size_t depth) {
+    const size_t tiles = A.tileCount();
+    std::vector<TileRef> order;
+    for (size_t ti = 0; ti < tiles; ++ti) {
+        for (size_t tj = 0; tj < tiles; ++tj) {
+            order.push_back({&A, ti, tj});
+            order.push_back({&B, ti, tj});
+        }
+    }
+    TileStream stream(std::move(order), A.tileFloats(), depth);
+    TileWriter writer(A.tileFloats(), depth);
+    float* out = tileAlloc(A.tileFloats());
+    for (size_t ti = 0; ti < tiles; ++ti) {
+        for (size_t tj = 0; tj < tiles; ++tj) {
+            const float* a = stream.next();
+            sse::addMatrix(a, stream.next(), out, A.tileSize());
+            stream.release(2);
+            writer.write(C, ti, tj, out);
+        }
+    }
+    writer.flush();
+    free(out);
+}
+
+inline void tiledIdentity(TiledMatrix& C, size_t depth) {
+    const size_t T = C.tileSize();
+    TileWriter writer(C.tileFloats(), depth);
+    float* buf = tileAlloc(C.tileFloats());
+    for (size_t ti = 0; ti < C.tileCount(); ++ti) {
+        for (size_t tj = 0; tj < C.tileCount(); ++tj) {
+            memset(buf, 0, C.tileBytes());
+            if (ti == tj) {
+                for (size_t r = 0; r < C.rowsIn(ti); ++r) {
+                    buf[r * T + r] = 1.0f;
+                }
+            }
+            writer.write(C, ti, tj, buf);
+        }
+    }
+    writer.flush();
+    free(buf);
+}
+
+/*
+ * B = A^T / (|A|_1 |A|_inf): первый проход по A собирает суммы строк и
+ * столбцов (2n float в памяти), второй транспонирует плитки.
+ */
+inline void tiledScaledTranspose(const TiledMatrix& A, TiledMatrix& B, size_t depth) {
+    const size_t tiles = A.tileCount();
+    const size_t T = A.tileSize();
+    std::vector<float> rowSums(tiles * T, 0.0f), colSums(tiles * T, 0.0f);
+    {
+        std::vector<TileRef> order;
+        for (size_t ti = 0; ti < tiles; ++ti) {
+            for (size_t tj = 0; tj < tiles; ++tj) {
+                order.push_back({&A, ti, tj});
+            }
+        }
+        TileStream stream(std::move(order), A.tileFloats(), depth);
+        for (size_t ti = 0; ti < tiles; ++ti) {
+            for (size_t tj = 0; tj < tiles; ++tj) {
+                const float* a = stream.next();
+                for (size_t r = 0; r < T; ++r) {
+                    for (size_t c = 0; c < T; ++c) {
+                        float v = fabsf(a[r * T + c]);
+                        rowSums[ti * T + r] += v;
+                        colSums[tj * T + c] += v;
+                    }
+                }
+                stream.release();
+            }
+        }
+    }
+    const float scale = *std::max_element(rowSums.begin(), rowSums.end()) *
+                        *std::max_element(colSums.begin(), colSums.end());
+    std::vector<TileRef> order;
+    for (size_t ti = 0; ti < tiles; ++ti) {
+        for (size_t tj = 0; tj < tiles; ++tj) {
+            order.push_back({&A, tj, ti});
+        }
+    }
+    TileStream stream(std::move(order), A.tileFloats(), depth);
+    TileWriter writer(A.tileFloats(), depth);
+    float* out = tileAlloc(A.tileFloats());
+    for (size_t ti = 0; ti < tiles; ++ti) {
+        for (size_t tj = 0; tj < tiles; ++tj) {
+            sse::transposeMatrix(stream.next(), out, T);
+            stream.release();
+            sse::divMatrix(out, out, scale, T);
+            writer.write(B, ti, tj, out);
+        }
+    }
+    writer.flush();
+    free(out);
+}
+
+/*
+ * Обращение рядом из M членов целиком на диске: те же шаги, что и
+ * matrixConversion, но каждая матрица - TiledMatrix в каталоге dir.
+ * cacheTiles - кэш строк A для умножений (см. tiledMul).
+ */
+inline void tiledInvert(const TiledMatrix& A, TiledMatrix& Res, size_t M, const std::string& dir,
+                        size_t depth, size_t cacheTiles, bool direct) {
+    const size_t n = A.size();
+    const size_t T = A.tileSize();
+    TiledMatrix B(dir + "/lab7_B.tiles", n, T, direct);
+    TiledMatrix R(dir + "/lab7_R.tiles", n, T, direct);
+    TiledMatrix sum(dir + "/lab7_sum.tiles", n, T, direct);
+    TiledMatrix power0(dir + "/lab7_power0.tiles", n, T, direct);
+    TiledMatrix power1(dir + "/lab7_power1.tiles", n, T, direct);
+
+    tiledScaledTranspose(A, B, depth);
+    tiledMul(B, A, R, depth, cacheTiles, -1.0f, true);
+    tiledIdentity(sum, depth);
+    const TiledMatrix* power = &R;
+    TiledMatrix* next = &power0;
+    for (size_t i = 1; i < M; ++i) {
+        tiledAdd(sum, *power, sum, depth);
+        if (i < M - 1) {
+            tiledMul(*power, R, *next, depth, cacheTiles);
+            power = next;
+            next = next == &power0 ? &power1 : &power0;
+        }
+    }
+    tiledMul(sum, B, Res, depth, cacheTiles);
+}
+
+#endif
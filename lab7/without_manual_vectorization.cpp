@@ -1,126 +1,18 @@
 #include <cmath>
 #include <algorithm>
+#include <chrono>
 #include <ctime>
 #include <iostream>
 #include <climits>
 #include <cstring>
 #include <random>
+#include <vector>
+#include "matrix_ops.h"
 
 using namespace std;
 
-void addMatrix(const float* A, const float* B, float* Res, const size_t N) {
-    for (size_t i = 0; i < N; ++i) {
-        for (size_t j = 0; j < N; ++j) {
-            Res[i * N + j] = A[i * N + j] + B[i * N + j];
-        }
-    }
-}
-
-void subMatrix(const float* A, const float* B, float* Res, const size_t N) {
-    for (size_t i = 0; i < N; ++i) {
-        for (size_t j = 0; j < N; ++j) {
-            Res[i * N + j] = A[i * N + j] - B[i * N + j];
-        }
-    }
-}
-
-void mulMatrix(const float* A, const float* B, float* Res, const size_t N) {
-    for (size_t i = 0; i < N * N; i++) {
-        Res[i] = 0.0f;
-    }
-    for (size_t i = 0; i < N; i++) {
-        for (size_t j = 0; j < N; j++) {
-            for (size_t k = 0; k < N; k++) {
-                Res[i * N + j] += A[i * N + k] * B[k * N + j];
-            }
-        }
-    }
-}
-
-void divMatrix(const float* A, float* Res, const float k, const size_t N) {
-    for (size_t i = 0; i < N; ++i) {
-        for (size_t j = 0; j < N; ++j) {
-            Res[i * N + j] = A[i * N + j] / k;
-        }
-    }
-}
-
-void transposeMatrix(const float* A, float* AT, const size_t N) {
-    for (size_t i = 0; i < N; ++i) {
-        for (size_t j = 0; j < N; ++j) {
-            AT[j * N + i] = A[i * N + j];
-        }
-    }
-}
-
-float findMaxAbsSumByRows(const float* A, const size_t N) {
-    float res = INT_MIN;
-    for (size_t i = 0; i < N; ++i) {
-        float sum = 0;
-        for (size_t j = 0; j < N; ++j) {
-            sum += fabsf(A[i * N + j]);
-        }
-        res = max(sum, res);
-    }
-    return res;
-}
-
-float findMaxAbsSumByColumns(const float* A, const size_t N) {
-    float res = INT_MIN;
-    for (size_t i = 0; i < N; ++i) {
-        float sum = 0;
-        for (size_t j = 0; j < N; ++j) {
-            sum += fabsf(A[j*N + i]);
-        }
-        res = max(sum, res);
-    }
-    return res;
-}
-
-void initIdentityMatrix(float* Res, const size_t N) {
-    memset(Res, 0, N * N * sizeof(float));
-    for (size_t i = 0; i < N; ++i) {
-        Res[i * N + i] = 1;
-    }
-}
-
 double matrixConversion(float* A, float* Res, const size_t N, const size_t M) {
-    float* B = new float[N * N];
-    float* AT = new float[N * N];
-    float* R = new float[N * N];
-    float* identityMatrix = new float[N * N];
-    float* tmp = new float[N * N];
-    float* tmp2 = new float[N * N];  // Дополнительный буфер
-
-    clock_t inversion_start = clock();
-    transposeMatrix(A, AT, N);
-    divMatrix(AT, B, findMaxAbsSumByColumns(A, N) * findMaxAbsSumByRows(A, N) , N);
-
-    mulMatrix(B, A, tmp, N);
-    initIdentityMatrix(identityMatrix, N);
-    subMatrix(identityMatrix, tmp, R, N);
-
-    initIdentityMatrix(Res, N);
-    memcpy(tmp, R, N * N * sizeof(float));
-
-    for (size_t i = 1; i < M; ++i) {
-        addMatrix(Res, tmp, Res, N);
-        if (i < M - 1) {
-            mulMatrix(tmp, R, tmp2, N);
-            memcpy(tmp, tmp2, N * N * sizeof(float));
-        }
-    }
-    mulMatrix(Res, B, tmp, N);
-    memcpy(Res, tmp, N * N * sizeof(float));
-    clock_t inversion_end = clock();
-
-    delete[] B;
-    delete[] AT;
-    delete[] R;
-    delete[] identityMatrix;
-    delete[] tmp;
-    delete[] tmp2;
-    return static_cast<double>(inversion_end - inversion_start) / CLOCKS_PER_SEC;
+    return invertMatrix(*matrixOpsByName("scalar"), A, Res, N, M);
 }
 
 void fillRandomMatrix(float* A, const size_t N) {
@@ -138,14 +30,63 @@ void printMatrix(const float* A, const size_t N){
     }
 }
 
-int main(void) {
+size_t nextThreadCount(size_t threads, size_t maxThreads) {
+    return threads * 2 <= maxThreads || threads == maxThreads ? threads * 2 : maxThreads;
+}
+
+/* Сильная масштабируемость: одно и то же обращение N x N на 1, 2, 4, ... maxThreads потоках. */
+void scalingBenchmark(const size_t N, const size_t M, size_t maxThreads) {
+    float* A = new float[N * N];
+    float* A_inv = new float[N * N];
+    fillRandomMatrix(A, N);
+    cout << "Потоки\tВремя, с\tУскорение\tЭффективность" << endl;
+    double single = 0;
+    for (size_t threads = 1; threads <= maxThreads; threads = nextThreadCount(threads, maxThreads)) {
+        threadPool().resize(threads);
+        double time = matrixConversion(A, A_inv, N, M);
+        if (threads == 1) {
+            single = time;
+        }
+        cout << threads << "\t" << time << "\t" << single / time << "\t" << single / time / threads << endl;
+    }
+    delete[] A;
+    delete[] A_inv;
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxThreads = threadPool().size();
+    bool scaling = false;
+    int repeat = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            maxThreads = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        } else if (strcmp(argv[i], "--huge-pages") == 0) {
+            workspace().setHugePages(true);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = max(atoi(argv[++i]), 1);
+        }
+    }
     const size_t N = 2048;
     const size_t M = 10;
+    if (scaling) {
+        scalingBenchmark(N, M, maxThreads);
+        return 0;
+    }
+    threadPool().resize(maxThreads);
     float* A = new float[N * N];
     float* A_inv = new float[N * N];
 	fillRandomMatrix(A, N);
-    double inversion_time = matrixConversion(A, A_inv, N, M);
-    cout << "Время обращения: " << inversion_time << " sec " << endl;
+    auto prepare_start = chrono::steady_clock::now();
+    workspace().reserve(OPS_COUNT, N);
+    double prepare_time = chrono::duration<double>(chrono::steady_clock::now() - prepare_start).count();
+    cout << "Рабочая область: " << workspace().bytes() / (1024 * 1024) << " МБ (" << workspace().backing()
+         << "), выделение и заполнение страниц: " << prepare_time << " sec (вынесено из замера)" << endl;
+    for (int r = 0; r < repeat; ++r) {
+        double inversion_time = matrixConversion(A, A_inv, N, M);
+        cout << "Время обращения: " << inversion_time << " sec " << endl;
+    }
     delete[] A_inv;
     cout << "Программа завершена." << endl;
     return 0;
@@ -0,0 +1,109 @@
+#ifndef LAB7_WORKSPACE_H
+#define LAB7_WORKSPACE_H
+
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+#include "thread_pool.h"
+
+/*
+ * Рабочая область для matrixConversion: один непрерывный кусок памяти,
+ * нарезанный на матрицы N x N с выравниванием по 64 байта. Выделяется один
+ * раз и растёт только при увеличении N, страницы заполняются нулями потоками
+ * пула заранее, чтобы page faults не попадали в замер. С hugePages сначала
+ * пробуются страницы hugetlbfs по 2 МБ, затем прозрачные huge pages.
+ */
+class Workspace {
+public:
+    ~Workspace() {
+        release();
+    }
+
+    void setHugePages(bool enable) {
+        if (enable != hugePages) {
+            release();
+            hugePages = enable;
+        }
+    }
+
+    /* Готовит count матриц N x N; возвращает true, если пришлось выделять память. */
+    bool reserve(size_t count, size_t N) {
+        stride = (N * N * sizeof(float) + 63) / 64 * 64;
+        size_t need = count * stride;
+        if (need <= capacity) {
+            return false;
+        }
+        release();
+        allocate(need);
+        prefault();
+        return true;
+    }
+
+    float* matrix(size_t index) const {
+        return reinterpret_cast<float*>(base + index * stride);
+    }
+
+    size_t bytes() const {
+        return capacity;
+    }
+
+    /* "hugetlb", "thp" или "4k" - чем на самом деле обеспечена память. */
+    const char* backing() const {
+        return backingName;
+    }
+
+private:
+    void allocate(size_t need) {
+        const size_t huge = 2u << 20;
+        if (hugePages) {
+            capacity = (need + huge - 1) / huge * huge;
+            void* p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                base = static_cast<char*>(p);
+                backingName = "hugetlb";
+                return;
+            }
+        } else {
+            capacity = (need + 4095) / 4096 * 4096;
+        }
+        void* p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        base = static_cast<char*>(p);
+        backingName = "4k";
+        if (hugePages && madvise(base, capacity, MADV_HUGEPAGE) == 0) {
+            backingName = "thp";
+        }
+    }
+
+    void prefault() {
+        const size_t pages = capacity / 4096;
+        parallelRows(pages, [&](size_t first, size_t last) {
+            memset(base + first * 4096, 0, (last - first) * 4096);
+        });
+    }
+
+    void release() {
+        if (base) {
+            munmap(base, capacity);
+        }
+        base = nullptr;
+        capacity = 0;
+    }
+
+    char* base = nullptr;
+    size_t capacity = 0;
+    size_t stride = 0;
+    bool hugePages = false;
+    const char* backingName = "4k";
+};
+
+/* Общая рабочая область программы. */
+inline Workspace& workspace() {
+    static Workspace ws;
+    return ws;
+}
+
+#endif
@@ -1,17 +1,29 @@
 #include <algorithm>
+#include <atomic>
 #include <climits>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <pthread.h>
 #include <random>
+#include <string>
+#include <thread>
 #include <vector>
+#include "../common/bench.h"
+#include "../common/numa.h"
+#include "../common/perf_counters.h"
 
 using namespace std;
 
-uint64_t getCpuTicks() {
-    unsigned int lo, hi;
-    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
-    return (static_cast<unsigned long long>(hi) << 32) | lo;
-}
+const size_t sizes[] = {
+    256, 512, 768, 1024, 1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192,
+    16384, 24576, 32768, 49152, 65536,
+    98304, 131072, 196608, 262144, 393216, 524288,
+    786432, 1048576, 1572864, 2097152, 3145728, 4194304,
+    6291456, 8388608
+};
+const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
 
 void warmCache(const int* arr, const size_t size) {
     volatile size_t k = 0;
@@ -28,22 +40,41 @@ size_t getK(size_t n) {
     return 5;
 }
 
-uint64_t measure(const int* arr, const size_t size, const size_t K) {
-    warmCache(arr, size);
-    uint64_t min_ticks = UINT64_MAX;
-    for (size_t i = 0; i < 5; ++i) {
-        volatile size_t k = 0;
-        uint64_t start = getCpuTicks();
-        for (size_t i = 0; i < size * K; ++i) {
-            k = arr[k];
-        }
-        uint64_t end = getCpuTicks();
-        uint64_t ticks = (end - start) / (size * K);
-        if (ticks < min_ticks) {
-            min_ticks = ticks;
-        }
+struct ChaseRun {
+    const int* arr;
+    size_t size;
+    size_t K;
+    perf_counters* perf;
+};
+
+struct Measurement {
+    bench_stats stats;
+    string counters;
+};
+
+double chaseOnce(void* ctx) {
+    const ChaseRun* run = static_cast<const ChaseRun*>(ctx);
+    volatile size_t k = 0;
+    perf_counters_start(run->perf);
+    uint64_t start = bench_cycles_begin();
+    for (size_t i = 0; i < run->size * run->K; ++i) {
+        k = run->arr[k];
     }
-    return min_ticks;
+    uint64_t end = bench_cycles_end();
+    perf_counters_stop(run->perf);
+    return static_cast<double>(end - start) / (run->size * run->K);
+}
+
+Measurement measure(const int* arr, const size_t size, const size_t K, const bench_config& cfg, perf_counters& perf) {
+    warmCache(arr, size);
+    ChaseRun run = {arr, size, K, &perf};
+    Measurement m;
+    char counters[512];
+    perf_counters_clear(&perf);
+    bench_run(chaseOnce, &run, &cfg, &m.stats);
+    perf_counters_values(&perf, static_cast<double>(size * K * m.stats.runs), ',', counters, sizeof(counters));
+    m.counters = counters;
+    return m;
 }
 
 void forwardFill(int* arr, const size_t n){
@@ -71,7 +102,534 @@ void randomFill(int* arr, const size_t n) {
     }
 }
 
-int main(void){
+void pinThread(unsigned cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % thread::hardware_concurrency(), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+struct SpinBarrier {
+    explicit SpinBarrier(size_t count) : count(count), waiting(0), phase(0) {}
+
+    void wait() {
+        size_t current = phase.load();
+        if (waiting.fetch_add(1) + 1 == count) {
+            waiting.store(0);
+            phase.fetch_add(1);
+        } else {
+            while (phase.load() == current) {
+                this_thread::yield();
+            }
+        }
+    }
+
+    const size_t count;
+    atomic<size_t> waiting;
+    atomic<size_t> phase;
+};
+
+enum Pattern { FORWARD, BACKWARD, RANDOM, PATTERN_COUNT };
+const char* patternNames[PATTERN_COUNT] = {"Forward", "Backward", "Random"};
+typedef void (*FillFunction)(int*, const size_t);
+const FillFunction fillFunctions[PATTERN_COUNT] = {forwardFill, backwardFill, randomFill};
+
+const size_t LOADED_ROUNDS = 3;
+const size_t STREAM_BYTES = 64 * 1024 * 1024;
+
+double chaseFrom(const int* arr, size_t start, size_t count) {
+    volatile size_t k = start;
+    uint64_t begin = bench_cycles_begin();
+    for (size_t i = 0; i < count; ++i) {
+        k = arr[k];
+    }
+    uint64_t end = bench_cycles_end();
+    return static_cast<double>(end - begin) / count;
+}
+
+double streamRead(const int* arr, size_t n, size_t reps) {
+    const uint64_t* p = reinterpret_cast<const uint64_t*>(arr);
+    size_t words = n / 2;
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    uint64_t begin = bench_cycles_begin();
+    for (size_t r = 0; r < reps; ++r) {
+        for (size_t i = 0; i + 3 < words; i += 4) {
+            s0 += p[i];
+            s1 += p[i + 1];
+            s2 += p[i + 2];
+            s3 += p[i + 3];
+        }
+    }
+    uint64_t end = bench_cycles_end();
+    volatile uint64_t sink = s0 + s1 + s2 + s3;
+    (void)sink;
+    return bench_cycles_to_ns(static_cast<double>(end - begin));
+}
+
+double streamWrite(int* arr, size_t n, size_t reps) {
+    uint64_t* p = reinterpret_cast<uint64_t*>(arr);
+    size_t words = n / 2;
+    uint64_t begin = bench_cycles_begin();
+    for (size_t r = 0; r < reps; ++r) {
+        for (size_t i = 0; i < words; ++i) {
+            p[i] = r + i;
+        }
+        __asm__ __volatile__("" : : "r"(p) : "memory");
+    }
+    uint64_t end = bench_cycles_end();
+    return bench_cycles_to_ns(static_cast<double>(end - begin));
+}
+
+struct ThreadResult {
+    double latency[PATTERN_COUNT];
+    double readGBs;
+    double writeGBs;
+};
+
+/*
+ * Все потоки одновременно обходят свои (или один общий) массивы из n элементов,
+ * синхронизируясь барьером перед каждым замером. Латентность потока - медиана
+ * по LOADED_ROUNDS раундам, пропускная способность - лучший раунд.
+ */
+void loadedWorker(unsigned id, size_t n, bool shared, int** sharedArrays, SpinBarrier& barrier, ThreadResult& result) {
+    pinThread(id);
+    size_t K = getK(n);
+    size_t threads = barrier.count;
+    int* own[PATTERN_COUNT] = {nullptr, nullptr, nullptr};
+    const int* arrays[PATTERN_COUNT];
+    for (int p = 0; p < PATTERN_COUNT; ++p) {
+        if (shared) {
+            arrays[p] = sharedArrays[p];
+        } else {
+            own[p] = new int[n];
+            fillFunctions[p](own[p], n);
+            arrays[p] = own[p];
+        }
+    }
+    size_t start = shared ? id * (n / threads) : 0;
+    for (int p = 0; p < PATTERN_COUNT; ++p) {
+        double samples[LOADED_ROUNDS];
+        warmCache(arrays[p], n);
+        for (size_t r = 0; r < LOADED_ROUNDS; ++r) {
+            barrier.wait();
+            samples[r] = chaseFrom(arrays[p], start, n * K);
+        }
+        bench_stats stats;
+        bench_compute_stats(samples, LOADED_ROUNDS, &stats);
+        result.latency[p] = stats.median;
+    }
+
+    int* stream = own[FORWARD] ? own[FORWARD] : new int[n];
+    if (!own[FORWARD]) {
+        memset(stream, 0, n * sizeof(int));
+    }
+    size_t bytes = n * sizeof(int);
+    size_t reps = max<size_t>(1, STREAM_BYTES / bytes);
+    double bestRead = 1e300, bestWrite = 1e300;
+    for (size_t r = 0; r < LOADED_ROUNDS; ++r) {
+        barrier.wait();
+        bestRead = min(bestRead, streamRead(stream, n, reps));
+        barrier.wait();
+        bestWrite = min(bestWrite, streamWrite(stream, n, reps));
+    }
+    result.readGBs = static_cast<double>(bytes) * reps / bestRead;
+    result.writeGBs = static_cast<double>(bytes) * reps / bestWrite;
+
+    if (!own[FORWARD]) {
+        delete[] stream;
+    }
+    for (int p = 0; p < PATTERN_COUNT; ++p) {
+        delete[] own[p];
+    }
+}
+
+unsigned nextThreadCount(unsigned threads, unsigned maxThreads) {
+    if (threads < maxThreads && threads * 2 > maxThreads) {
+        return maxThreads;
+    }
+    return threads * 2;
+}
+
+int runLoadedSweep(unsigned maxThreads, bool shared) {
+    ofstream file("loaded.csv");
+    if (!file.is_open()) {
+        cout << "Cannot open file" << endl;
+        return 1;
+    }
+    file << "N,Threads";
+    for (int p = 0; p < PATTERN_COUNT; ++p) {
+        file << "," << patternNames[p] << "_mean," << patternNames[p] << "_min," << patternNames[p] << "_max,"
+             << patternNames[p] << "_ns";
+    }
+    file << ",Read_GBs,Write_GBs,Read_GBs_thread_mean,Read_GBs_thread_min,Read_GBs_thread_max,"
+         << "Write_GBs_thread_mean,Write_GBs_thread_min,Write_GBs_thread_max" << endl;
+
+    for (size_t i = 0; i < num_sizes; ++i) {
+        size_t n = sizes[i];
+        int* sharedArrays[PATTERN_COUNT] = {nullptr, nullptr, nullptr};
+        if (shared) {
+            for (int p = 0; p < PATTERN_COUNT; ++p) {
+                sharedArrays[p] = new int[n];
+                fillFunctions[p](sharedArrays[p], n);
+            }
+        }
+        for (unsigned threads = 1; threads <= maxThreads; threads = nextThreadCount(threads, maxThreads)) {
+            SpinBarrier barrier(threads);
+            vector<ThreadResult> results(threads);
+            vector<thread> workers;
+            for (unsigned t = 0; t < threads; ++t) {
+                workers.emplace_back(loadedWorker, t, n, shared, sharedArrays, ref(barrier), ref(results[t]));
+            }
+            for (thread& w : workers) {
+                w.join();
+            }
+
+            file << (n * 4) / 1024 << "," << threads;
+            for (int p = 0; p < PATTERN_COUNT; ++p) {
+                double sum = 0, lo = 1e300, hi = 0;
+                for (const ThreadResult& r : results) {
+                    sum += r.latency[p];
+                    lo = min(lo, r.latency[p]);
+                    hi = max(hi, r.latency[p]);
+                }
+                double mean = sum / threads;
+                file << "," << mean << "," << lo << "," << hi << "," << bench_cycles_to_ns(mean);
+            }
+            // Суммарная полоса и разброс по потокам: среднее скрыло бы ядра, которым досталось меньше.
+            double read = 0, write = 0, readLo = 1e300, readHi = 0, writeLo = 1e300, writeHi = 0;
+            for (const ThreadResult& r : results) {
+                read += r.readGBs;
+                write += r.writeGBs;
+                readLo = min(readLo, r.readGBs);
+                readHi = max(readHi, r.readGBs);
+                writeLo = min(writeLo, r.writeGBs);
+                writeHi = max(writeHi, r.writeGBs);
+            }
+            file << "," << read << "," << write << "," << read / threads << "," << readLo << "," << readHi << ","
+                 << write / threads << "," << writeLo << "," << writeHi << endl;
+            cout << (n * 4) / 1024 << " KB, " << threads << " threads: random " << results[0].latency[RANDOM]
+                 << " cycles, read " << read << " GB/s (" << readLo << ".." << readHi << " per thread), write "
+                 << write << " GB/s (" << writeLo << ".." << writeHi << " per thread)" << endl;
+        }
+        for (int p = 0; p < PATTERN_COUNT; ++p) {
+            delete[] sharedArrays[p];
+        }
+    }
+    file.close();
+    return 0;
+}
+
+/* nullptr, если память не выделилась; сообщение уже выведено. huge - на прозрачных 2M-страницах. */
+int* allocArray(size_t n, int node, bool huge = false) {
+    void* p = huge ? node_alloc_huge(n * sizeof(int), node) : node_alloc(n * sizeof(int), node);
+    int* arr = static_cast<int*>(p);
+    if (arr == nullptr) {
+        cout << "Cannot allocate " << (n * sizeof(int)) / 1024 << " KB on node " << node << endl;
+    }
+    return arr;
+}
+
+void freeArray(int* arr, size_t n) {
+    node_free(arr, n * sizeof(int));
+}
+
+struct NumaCell {
+    double latency;
+    double readGBs;
+    bool ok;
+};
+
+void numaCellWorker(int cpuNode, int memNode, size_t n, NumaCell& cell) {
+    node_bind_thread(cpuNode);
+    int* arr = allocArray(n, memNode);
+    cell.ok = arr != nullptr;
+    if (!cell.ok) {
+        return;
+    }
+    randomFill(arr, n);
+    warmCache(arr, n);
+    double samples[LOADED_ROUNDS];
+    for (size_t r = 0; r < LOADED_ROUNDS; ++r) {
+        samples[r] = chaseFrom(arr, 0, n * getK(n));
+    }
+    bench_stats stats;
+    bench_compute_stats(samples, LOADED_ROUNDS, &stats);
+    cell.latency = stats.median;
+    double best = 1e300;
+    for (size_t r = 0; r < LOADED_ROUNDS; ++r) {
+        best = min(best, streamRead(arr, n, 1));
+    }
+    cell.readGBs = static_cast<double>(n * sizeof(int)) / best;
+    freeArray(arr, n);
+}
+
+/*
+ * Для каждой пары (узел потока, узел памяти) измеряет латентность случайного
+ * обхода и потоковое чтение буфера из самого большого размера sizes[].
+ */
+int runNumaMatrix() {
+    int nodes[NODE_MAX];
+    int count = node_list_online(nodes, NODE_MAX);
+    size_t n = sizes[num_sizes - 1];
+    ofstream file("numa.csv");
+    if (!file.is_open()) {
+        cout << "Cannot open file" << endl;
+        return 1;
+    }
+    file << "CpuNode,MemNode,Latency,Latency_ns,Read_GBs" << endl;
+    vector<NumaCell> cells(count * count);
+    for (int c = 0; c < count; ++c) {
+        for (int m = 0; m < count; ++m) {
+            NumaCell& cell = cells[c * count + m];
+            thread worker(numaCellWorker, nodes[c], nodes[m], n, ref(cell));
+            worker.join();
+            if (!cell.ok) {
+                return 1;
+            }
+            file << nodes[c] << "," << nodes[m] << "," << cell.latency << "," << bench_cycles_to_ns(cell.latency)
+                 << "," << cell.readGBs << endl;
+        }
+    }
+    file.close();
+
+    cout << "Latency, ns (rows: cpu node, columns: memory node)" << endl << "cpu\\mem";
+    for (int m = 0; m < count; ++m) {
+        cout << "\t" << nodes[m];
+    }
+    cout << endl;
+    for (int c = 0; c < count; ++c) {
+        cout << nodes[c];
+        for (int m = 0; m < count; ++m) {
+            cout << "\t" << bench_cycles_to_ns(cells[c * count + m].latency);
+        }
+        cout << endl;
+    }
+    cout << "Read bandwidth, GB/s" << endl << "cpu\\mem";
+    for (int m = 0; m < count; ++m) {
+        cout << "\t" << nodes[m];
+    }
+    cout << endl;
+    for (int c = 0; c < count; ++c) {
+        cout << nodes[c];
+        for (int m = 0; m < count; ++m) {
+            cout << "\t" << cells[c * count + m].readGBs;
+        }
+        cout << endl;
+    }
+    return 0;
+}
+
+const size_t MLP_MAX_CHAINS = 32;
+const double MLP_KNEE_SHARE = 0.9;
+
+/*
+ * chains независимых случайных циклов в одном массиве: случайная перестановка
+ * индексов режется на chains равных отрезков, каждый отрезок замыкается в
+ * цикл, heads получает по элементу каждого цикла. Остаток от деления
+ * ссылается сам на себя и не обходится.
+ */
+void interleavedFill(int* arr, const size_t n, const size_t chains, size_t* heads) {
+    vector<size_t> index(n);
+    for (size_t i = 0; i < n; ++i) {
+        index[i] = i;
+    }
+    random_device rd;
+    mt19937 g(rd());
+    shuffle(index.begin(), index.end(), g);
+    size_t length = n / chains;
+    for (size_t c = 0; c < chains; ++c) {
+        const size_t* cycle = &index[c * length];
+        for (size_t j = 0; j < length; ++j) {
+            arr[cycle[j]] = cycle[(j + 1) % length];
+        }
+        heads[c] = cycle[0];
+    }
+    for (size_t i = chains * length; i < n; ++i) {
+        arr[index[i]] = index[i];
+    }
+}
+
+/* Шаг всех K цепочек; рекурсия раскрывается компилятором в K независимых загрузок. */
+template <size_t K>
+struct ChainStep {
+    static inline void run(const int* arr, size_t* k) {
+        ChainStep<K - 1>::run(arr, k);
+        k[K - 1] = arr[k[K - 1]];
+    }
+};
+
+template <>
+struct ChainStep<0> {
+    static inline void run(const int*, size_t*) {}
+};
+
+/* Такты на одно обращение при обходе K цепочек вперемешку, steps шагов каждой. */
+template <size_t K>
+double chaseInterleaved(const int* arr, const size_t* heads, size_t steps) {
+    size_t k[K];
+    for (size_t c = 0; c < K; ++c) {
+        k[c] = heads[c];
+    }
+    uint64_t begin = bench_cycles_begin();
+    for (size_t i = 0; i < steps; ++i) {
+        ChainStep<K>::run(arr, k);
+    }
+    uint64_t end = bench_cycles_end();
+    size_t sum = 0;
+    for (size_t c = 0; c < K; ++c) {
+        sum += k[c];
+    }
+    volatile size_t sink = sum;
+    (void)sink;
+    return static_cast<double>(end - begin) / (steps * K);
+}
+
+typedef double (*InterleavedChase)(const int*, const size_t*, size_t);
+
+template <size_t K>
+struct ChaseTable {
+    static void fill(InterleavedChase* table) {
+        table[K - 1] = chaseInterleaved<K>;
+        ChaseTable<K - 1>::fill(table);
+    }
+};
+
+template <>
+struct ChaseTable<0> {
+    static void fill(InterleavedChase*) {}
+};
+
+struct MlpRun {
+    InterleavedChase chase;
+    const int* arr;
+    const size_t* heads;
+    size_t steps;
+};
+
+double mlpOnce(void* ctx) {
+    const MlpRun* run = static_cast<const MlpRun*>(ctx);
+    return run->chase(run->arr, run->heads, run->steps);
+}
+
+/*
+ * Параллелизм памяти: для каждого размера и K = 1..maxChains обходятся K
+ * независимых случайных цепочек в одном цикле. Пока промахи разных цепочек
+ * перекрываются, время на обращение падает примерно как 1/K; колено кривой
+ * показывает, сколько промахов ядро держит одновременно (LFB/MSHR).
+ * Время на обращение в нс - в mlp.csv, по строке на размер, последний
+ * столбец - колено.
+ *
+ * Массив лежит на прозрачных 2M-страницах: на 4K-страницах каждый промах
+ * по большому массиву добавляет ещё и обход таблиц страниц, и эти обходы
+ * тоже перекрываются, завышая выигрыш от K. Коленом считается наименьшее
+ * K, дающее MLP_KNEE_SHARE от лучшего ускорения: дальше кривая плоская,
+ * и минимум там определяется шумом.
+ */
+int runMlpSweep(size_t maxChains, int memNode) {
+    ofstream file("mlp.csv");
+    if (!file.is_open()) {
+        cout << "Cannot open file" << endl;
+        return 1;
+    }
+    InterleavedChase table[MLP_MAX_CHAINS];
+    ChaseTable<MLP_MAX_CHAINS>::fill(table);
+
+    file << "N";
+    for (size_t K = 1; K <= maxChains; ++K) {
+        file << ",K" << K;
+    }
+    file << ",Knee" << endl;
+
+    bench_config cfg = bench_make_config(3, 10, 0.02);
+    bench_report report = bench_report_open("lab8", "bench.csv");
+    const size_t minAccesses = 1 << 20;
+    size_t heads[MLP_MAX_CHAINS];
+    for (size_t i = 0; i < num_sizes; ++i) {
+        size_t n = sizes[i];
+        int* arr = allocArray(n, memNode, true);
+        if (arr == nullptr) {
+            return 1;
+        }
+        string param = to_string((n * 4) / 1024);
+        file << param;
+        double single = 0, best = 1e300;
+        size_t bestChains = 1;
+        double perChain[MLP_MAX_CHAINS];
+        for (size_t K = 1; K <= maxChains; ++K) {
+            interleavedFill(arr, n, K, heads);
+            MlpRun run = {table[K - 1], arr, heads, max(n, minAccesses) / K};
+            table[K - 1](arr, heads, n / K);
+            bench_stats stats;
+            bench_run(mlpOnce, &run, &cfg, &stats);
+            string name = "mlp_k" + to_string(K);
+            bench_report_write(&report, name.c_str(), param.c_str(), "cycles", &stats);
+            double ns = bench_cycles_to_ns(stats.median);
+            perChain[K - 1] = ns;
+            file << "," << ns;
+            if (K == 1) {
+                single = ns;
+            }
+            if (ns < best) {
+                best = ns;
+                bestChains = K;
+            }
+        }
+        size_t knee = bestChains;
+        for (size_t K = 1; K < bestChains; ++K) {
+            if (single / perChain[K - 1] >= MLP_KNEE_SHARE * (single / best)) {
+                knee = K;
+                break;
+            }
+        }
+        file << "," << knee << endl;
+        cout << param << " KB: " << single << " ns/access with 1 chain, " << best << " ns with " << bestChains
+             << " chains, overlap x" << single / best << ", knee at " << knee << " chains (x"
+             << single / perChain[knee - 1] << ")" << endl;
+        freeArray(arr, n);
+    }
+    file.close();
+    bench_report_close(&report);
+    return 0;
+}
+
+int main(int argc, char** argv){
+    unsigned loadedThreads = 0;
+    bool shared = false;
+    bool numa = false;
+    int cpuNode = -1;
+    int memNode = -1;
+    size_t mlpChains = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            loadedThreads = static_cast<unsigned>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--shared") == 0) {
+            shared = true;
+        } else if (strcmp(argv[i], "--numa") == 0) {
+            numa = true;
+        } else if (strcmp(argv[i], "--cpu-node") == 0 && i + 1 < argc) {
+            cpuNode = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mem-node") == 0 && i + 1 < argc) {
+            memNode = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mlp") == 0) {
+            mlpChains = MLP_MAX_CHAINS;
+        } else if (strcmp(argv[i], "--mlp-max-k") == 0 && i + 1 < argc) {
+            mlpChains = min<size_t>(max(atoi(argv[++i]), 1), MLP_MAX_CHAINS);
+        }
+    }
+    if (numa) {
+        return runNumaMatrix();
+    }
+    if (loadedThreads > 0) {
+        return runLoadedSweep(loadedThreads, shared);
+    }
+    if (cpuNode >= 0 && !node_bind_thread(cpuNode)) {
+        cout << "Cannot bind to node " << cpuNode << endl;
+        return 1;
+    }
+    if (mlpChains > 0) {
+        return runMlpSweep(mlpChains, memNode);
+    }
+
     const size_t minN = 256;         //1Кб
     const size_t maxN = 8388608;     //32Мб
 
@@ -81,35 +639,46 @@ int main(void){
         return 1;
     }
 
-    size_t sizes[] = {
-        256, 512, 768, 1024, 1280, 1536, 1792, 2048,
-        2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192,
-        16384, 24576, 32768, 49152, 65536,
-        98304, 131072, 196608, 262144, 393216, 524288,
-        786432, 1048576, 1572864, 2097152, 3145728, 4194304,
-        6291456, 8388608
-    };
-
-    const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
-    file << "N,Forward,Backward,Random" << endl;
+    bench_config cfg = bench_make_config(5, 50, 0.01);
+    bench_report report = bench_report_open("lab8", "bench.csv");
+    perf_counters perf;
+    perf_counters_open(&perf);
+    char header[3][512];
+    perf_counters_header(&perf, "Forward_", ',', header[0], sizeof(header[0]));
+    perf_counters_header(&perf, "Backward_", ',', header[1], sizeof(header[1]));
+    perf_counters_header(&perf, "Random_", ',', header[2], sizeof(header[2]));
+    file << "N,Forward,Backward,Random" << header[0] << header[1] << header[2] << endl;
     for(size_t i = 0; i < num_sizes; ++i){
         size_t n = sizes[i];
         size_t K = getK(n);
-        int* arr_forward = new int[n];
-        int* arr_backward = new int[n];
-        int* arr_random = new int[n];
+        int* arr_forward = allocArray(n, memNode);
+        int* arr_backward = allocArray(n, memNode);
+        int* arr_random = allocArray(n, memNode);
+        if (!arr_forward || !arr_backward || !arr_random) {
+            freeArray(arr_forward, n);
+            freeArray(arr_backward, n);
+            freeArray(arr_random, n);
+            return 1;
+        }
         forwardFill(arr_forward, n);
         backwardFill(arr_backward, n);
         randomFill(arr_random, n);
-        uint64_t ticks_forward = measure(arr_forward, n, K);
-        uint64_t ticks_backward = measure(arr_backward, n, K);
-        uint64_t ticks_random = measure(arr_random, n, K);
+        Measurement ticks_forward = measure(arr_forward, n, K, cfg, perf);
+        Measurement ticks_backward = measure(arr_backward, n, K, cfg, perf);
+        Measurement ticks_random = measure(arr_random, n, K, cfg, perf);
 
-        file << (n * 4) / 1024 << "," << ticks_forward << "," << ticks_backward << "," << ticks_random << endl;
-        delete[] arr_forward;
-        delete[] arr_backward;
-        delete[] arr_random;
+        string param = to_string((n * 4) / 1024);
+        bench_report_write(&report, "forward", param.c_str(), "cycles", &ticks_forward.stats);
+        bench_report_write(&report, "backward", param.c_str(), "cycles", &ticks_backward.stats);
+        bench_report_write(&report, "random", param.c_str(), "cycles", &ticks_random.stats);
+        file << param << "," << ticks_forward.stats.median << "," << ticks_backward.stats.median << "," << ticks_random.stats.median
+             << ticks_forward.counters << ticks_backward.counters << ticks_random.counters << endl;
+        freeArray(arr_forward, n);
+        freeArray(arr_backward, n);
+        freeArray(arr_random, n);
     }
     file.close();
+    perf_counters_close(&perf);
+    bench_report_close(&report);
     return 0;
 }
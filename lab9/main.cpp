@@ -1,17 +1,21 @@
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <string>
+#include "../common/bench.h"
+#include "../common/numa.h"
+#include "../common/perf_counters.h"
 
 using namespace std;
 
-uint64_t getCpuTicks() {
-    unsigned int lo, hi;
-    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
-    return ((uint64_t)hi << 32) | lo;
-}
-
-int* initArray(size_t fragCount, size_t size, size_t offset) {
-    int* array = new int[offset*fragCount];
+int* initArray(size_t fragCount, size_t size, size_t offset, int memNode) {
+    int* array = static_cast<int*>(node_alloc(offset * fragCount * sizeof(int), memNode));
+    if (array == nullptr) {
+        cout << "Cannot allocate " << (offset * fragCount * sizeof(int)) / (1024 * 1024) << " MB on node " << memNode << endl;
+        return nullptr;
+    }
     for (size_t i = 0; i < size / fragCount; ++i) {
         for (size_t j = 0; j < fragCount - 1; ++j) {
             array[i + j * offset] = i + (j + 1) * offset;
@@ -21,21 +25,47 @@ int* initArray(size_t fragCount, size_t size, size_t offset) {
     return array;
 }
 
-uint64_t getMinTicks(int* array, size_t size) {
-    uint64_t start, end;
-    uint64_t min_ticks = UINT64_MAX;
-    for (size_t j = 0; j < 10; ++j){
-        start = getCpuTicks();
-        for(volatile size_t k = 0, i = 0; i < size; ++i) {
-            k = array[k];
-        }
-        end = getCpuTicks();
-        min_ticks = min(min_ticks, end - start);
+struct Traversal {
+    int* array;
+    size_t size;
+    perf_counters* perf;
+};
+
+double traverseOnce(void* ctx) {
+    Traversal* t = static_cast<Traversal*>(ctx);
+    perf_counters_start(t->perf);
+    uint64_t start = bench_cycles_begin();
+    for(volatile size_t k = 0, i = 0; i < t->size; ++i) {
+        k = t->array[k];
     }
-    return min_ticks/size;
+    uint64_t end = bench_cycles_end();
+    perf_counters_stop(t->perf);
+    return static_cast<double>(end - start) / t->size;
+}
+
+/* Статистика тактов на обращение по сериям обхода; в results.csv идёт медиана. */
+bench_stats measureTicks(int* array, size_t size, const bench_config& cfg, perf_counters& perf) {
+    Traversal t = {array, size, &perf};
+    bench_stats stats;
+    perf_counters_clear(&perf);
+    bench_run(traverseOnce, &t, &cfg, &stats);
+    return stats;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    int cpuNode = -1;
+    int memNode = -1;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--cpu-node") == 0) {
+            cpuNode = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mem-node") == 0) {
+            memNode = atoi(argv[++i]);
+        }
+    }
+    if (cpuNode >= 0 && !node_bind_thread(cpuNode)) {
+        cout << "Cannot bind to node " << cpuNode << endl;
+        return 1;
+    }
     size_t offset = (8 * 1024 * 1024) / sizeof(int);   
     size_t size = (32 * 1024) / sizeof(int);
     ofstream file("results.csv");
@@ -43,12 +73,26 @@ int main() {
         cout << "Cannot open file" << endl;
         return 1;
     }
-    file << "Fragment Count, Ticks" << endl;
+    bench_config cfg = bench_make_config(10, 100, 0.01);
+    bench_report report = bench_report_open("lab9", "bench.csv");
+    perf_counters perf;
+    perf_counters_open(&perf);
+    char counters[512];
+    perf_counters_header(&perf, "", ',', counters, sizeof(counters));
+    file << "Fragment Count, Ticks" << counters << endl;
     for (size_t fragCount = 1; fragCount <= 32; ++fragCount){
-        int* array = initArray(fragCount, size, offset);
-        file << fragCount << "," << getMinTicks(array, size) << endl;
-        delete[] array;
+        int* array = initArray(fragCount, size, offset, memNode);
+        if (array == nullptr) {
+            return 1;
+        }
+        bench_stats stats = measureTicks(array, size, cfg, perf);
+        bench_report_write(&report, "fragments", to_string(fragCount).c_str(), "cycles", &stats);
+        perf_counters_values(&perf, static_cast<double>(size * stats.runs), ',', counters, sizeof(counters));
+        file << fragCount << "," << stats.median << counters << endl;
+        node_free(array, offset * fragCount * sizeof(int));
     }
     file.close();
+    perf_counters_close(&perf);
+    bench_report_close(&report);
     return 0;
 }